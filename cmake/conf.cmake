@@ -2,3 +2,9 @@ set(CMAKE_POSITION_INDEPENDENT_CODE ON)
 set(CMAKE_EXPORT_COMPILE_COMMANDS ON)
 set(NEMU_SOURCE_REGEX "[a-z_]")
 set(NEMU_ROOT ${CMAKE_SOURCE_DIR})
+
+# Record every instruction executed into a trace buffer, off by default as it costs a call per instruction
+option(NEMU_TRACE "Build the CPU trace hooks" OFF)
+
+# Count the memory accesses of the console per address, off by default as it costs a counter per access
+option(NEMU_PROFILE "Build the memory access profiler hooks" OFF)
@@ -0,0 +1,288 @@
+#include "benchmarks.hpp"
+#include "mapper/mapper_mmc1.hpp"
+#include "nes.hpp"
+#include "ppu/palette.hpp"
+#include "workload.hpp"
+#include <fmt/format.h>
+#include <memory>
+
+namespace nemu::bench {
+
+using namespace workload;
+
+struct Program {
+  std::string_view name;
+  std::span<const uint8> program;
+  uint16 nmi;
+};
+
+struct Region {
+  std::string_view name;
+  uint16 begin, end;
+};
+
+void add_cpu_benchmarks(Suite &suite) {
+  constexpr uint32 TICKS = 10000;
+
+  constexpr Program STREAMS[] = {
+    {"alu", ALU_PROGRAM, ALU_NMI},
+    {"memory", MEMORY_PROGRAM, MEMORY_NMI},
+    {"branch", BRANCH_PROGRAM, BRANCH_NMI},
+  };
+
+  for (const Program &stream : STREAMS) {
+    suite.add(fmt::format("cpu/tick/{}", stream.name), "instruction", [=] {
+      auto console = std::make_shared<Console>(stream.program, stream.nmi);
+
+      return [console] {
+        Cpu &cpu = console->nes->cpu();
+        uint32 instructions = cpu.instruction_counter();
+
+        for (uint32 n = 0; n < TICKS; n++) {
+          cpu.tick();
+        }
+
+        return uint32(cpu.instruction_counter() - instructions);
+      };
+    });
+
+    // Through the scheduler, which only catches the PPU up when needed
+    suite.add(fmt::format("cpu/run/{}", stream.name), "instruction", [=] {
+      auto console = std::make_shared<Console>(stream.program, stream.nmi);
+
+      return [console] {
+        return console->nes->run_until(console->nes->cycles() + TICKS).instructions;
+      };
+    });
+  }
+}
+
+void add_bus_benchmarks(Suite &suite) {
+  constexpr uint32 READS = 4096;
+
+  constexpr Region REGIONS[] = {
+    {"ram", 0x0000, 0x1FFF},
+    {"ppu", 0x2000, 0x3FFF},
+    {"io", 0x4000, 0x401F},
+    {"prg_ram", 0x6000, 0x7FFF},
+    {"prg_rom", 0x8000, 0xFFFF},
+  };
+
+  for (const Region &region : REGIONS) {
+    // The handlers behind the page table, then the page table itself
+    suite.add(fmt::format("nes/cpu_read/{}", region.name), "read", [=] {
+      auto console = std::make_shared<Console>(BRANCH_PROGRAM, BRANCH_NMI, 1);
+
+      return [console, region] {
+        uint8 sum = 0;
+
+        for (uint32 n = 0; n < READS; n++) {
+          sum += console->nes->cpu_read(region.begin + n % (region.end - region.begin + 1));
+        }
+
+        do_not_optimize(sum);
+        return READS;
+      };
+    });
+
+    suite.add(fmt::format("bus/read/{}", region.name), "read", [=] {
+      auto console = std::make_shared<Console>(BRANCH_PROGRAM, BRANCH_NMI, 1);
+
+      return [console, region] {
+        uint8 sum = 0;
+
+        for (uint32 n = 0; n < READS; n++) {
+          sum += console->nes->read(region.begin + n % (region.end - region.begin + 1));
+        }
+
+        do_not_optimize(sum);
+        return READS;
+      };
+    });
+  }
+}
+
+void add_ppu_benchmarks(Suite &suite) {
+  // Let the program fill the nametables, the palette and the OAM
+  auto make_console = [] {
+    auto console = std::make_shared<Console>(RENDER_PROGRAM, RENDER_NMI);
+
+    for (uint8 n = 0; n < 30; n++) {
+      console->nes->run_frame();
+    }
+
+    return console;
+  };
+
+  suite.add("ppu/render_background", "pixel", [=] {
+    return [console = make_console()] {
+      Ppu &ppu = console->nes->ppu();
+
+      for (uint8 j = 0; j < Canvas::H; j++) {
+        ppu.render_background(ppu.canvas(), j);
+      }
+
+      return Canvas::W * Canvas::H;
+    };
+  });
+
+  suite.add("ppu/render_sprites", "sprite", [=] {
+    return [console = make_console()] {
+      Ppu &ppu = console->nes->ppu();
+      ppu.render_sprites(ppu.canvas());
+
+      return 64;
+    };
+  });
+}
+
+void add_mapper_benchmarks(Suite &suite) {
+  constexpr uint32 MAPS = 4096;
+
+  constexpr std::pair<uint8, std::string_view> PRG_MODES[] = {
+    {0b00, "32k"},
+    {0b10, "fix_first"},
+    {0b11, "fix_last"},
+  };
+
+  for (auto [mode, mode_name] : PRG_MODES) {
+    suite.add(fmt::format("mapper/mmc1/map_prg/{}", mode_name), "address", [=] {
+      auto console = std::make_shared<Console>(BRANCH_PROGRAM, BRANCH_NMI, 1);
+      auto mapper = std::static_pointer_cast<MapperMmc1>(console->nes->mapper());
+
+      // The control register is written serially, one bit per write
+      for (uint8 n = 0; n < 5; n++) {
+        console->nes->cpu_write(0x8000, (mode << 2) >> n & 0b1);
+      }
+
+      return [console, mapper] {
+        uint32 sum = 0;
+
+        for (uint32 n = 0; n < MAPS; n++) {
+          sum += mapper->map_prg(0x8000 | (n * 0x3D & 0x7FFF));
+        }
+
+        do_not_optimize(sum);
+        return MAPS;
+      };
+    });
+  }
+}
+
+void add_palette_benchmarks(Suite &suite) {
+  std::vector<std::pair<std::string_view, ppu::ConvertRow>> conversions = {{"scalar", ppu::convert_row}};
+
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    conversions.emplace_back("avx2", ppu::convert_row_avx2);
+  }
+#endif
+
+  for (auto [name, convert_row] : conversions) {
+    suite.add(fmt::format("palette/convert_row/{}", name), "pixel", [=] {
+      auto canvas = std::make_shared<Canvas>();
+      auto texels = std::make_shared<std::vector<uint32>>(Canvas::W * Canvas::H);
+
+      for (uint32 n = 0; n < canvas->buffer.size(); n++) {
+        canvas->buffer[n] = n * 7 & 0x3F;
+      }
+
+      return [=] {
+        for (uint16 y = 0; y < Canvas::H; y++) {
+          convert_row(&(*texels)[y * Canvas::W], canvas->row(y).data());
+        }
+
+        do_not_optimize(texels->back());
+        return Canvas::W * Canvas::H;
+      };
+    });
+  }
+
+  // Produce the canvas and convert it like the renderer does, along the scanlines or along the columns
+  for (auto [scanlines, name] : {std::pair {false, "columns"}, std::pair {true, "scanlines"}}) {
+    suite.add(fmt::format("canvas/traverse/{}", name), "pixel", [=] {
+      auto canvas = std::make_shared<Canvas>();
+      auto texels = std::make_shared<std::vector<uint32>>(Canvas::W * Canvas::H);
+
+      return [=, n = uint32 {}]() mutable {
+        auto pixel = [&](uint16 x, uint16 y) {
+          canvas->at(x, y) = (x ^ y ^ n) & 0x3F;
+          (*texels)[y * Canvas::W + x] = ppu::TEXELS[canvas->at(x, y)];
+        };
+
+        for (uint16 i = 0; i < (scanlines ? Canvas::H : Canvas::W); i++) {
+          for (uint16 j = 0; j < (scanlines ? Canvas::W : Canvas::H); j++) {
+            scanlines ? pixel(j, i) : pixel(i, j);
+          }
+        }
+
+        do_not_optimize(texels->back()), n++;
+        return Canvas::W * Canvas::H;
+      };
+    });
+  }
+}
+
+void add_state_benchmarks(Suite &suite) {
+  for (auto [mapper, mapper_name] : {std::pair<uint8, std::string_view> {0, "nrom"}, {1, "mmc1"}}) {
+    auto make_console = [=] {
+      auto console = std::make_shared<Console>(RENDER_PROGRAM, RENDER_NMI, mapper);
+
+      for (uint8 n = 0; n < 10; n++) {
+        console->nes->run_frame();
+      }
+
+      return console;
+    };
+
+    suite.add(fmt::format("nes/save/{}", mapper_name), "byte", [=] {
+      auto state = std::make_shared<std::vector<std::byte>>();
+
+      return [console = make_console(), state] {
+        state->resize(console->nes->state_size());
+        return console->nes->save(*state);
+      };
+    });
+
+    suite.add(fmt::format("nes/load/{}", mapper_name), "byte", [=] {
+      auto console = make_console();
+      auto state = std::make_shared<std::vector<std::byte>>(console->nes->state_size());
+      console->nes->save(*state);
+
+      return [console, state] {
+        console->nes->load(*state);
+        return state->size();
+      };
+    });
+  }
+}
+
+void add_rom_benchmarks(Suite &suite) {
+  constexpr Program ROMS[] = {
+    {"loop", WORKLOAD_PROGRAM, WORKLOAD_NMI},
+    {"render", RENDER_PROGRAM, RENDER_NMI},
+  };
+
+  for (const Program &rom : ROMS) {
+    suite.add(fmt::format("rom/{}", rom.name), "frame", [=] {
+      auto console = std::make_shared<Console>(rom.program, rom.nmi);
+
+      return [console] {
+        console->nes->run_frame();
+        return 1;
+      };
+    });
+  }
+}
+
+void add_benchmarks(Suite &suite) {
+  add_cpu_benchmarks(suite);
+  add_bus_benchmarks(suite);
+  add_ppu_benchmarks(suite);
+  add_mapper_benchmarks(suite);
+  add_palette_benchmarks(suite);
+  add_state_benchmarks(suite);
+  add_rom_benchmarks(suite);
+}
+
+}  // namespace nemu::bench
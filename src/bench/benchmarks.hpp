@@ -0,0 +1,12 @@
+#ifndef NEMU_BENCH_BENCHMARKS_HPP
+#define NEMU_BENCH_BENCHMARKS_HPP
+
+#include "suite.hpp"
+
+namespace nemu::bench {
+
+void add_benchmarks(Suite &suite);
+
+}  // namespace nemu::bench
+
+#endif
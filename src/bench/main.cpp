@@ -0,0 +1,80 @@
+#include "benchmarks.hpp"
+#include "exception.hpp"
+#include "suite.hpp"
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string>
+
+using namespace nemu;
+
+constexpr std::string_view CLI_USAGE = R"(
+NEMU benchmarks usage:
+  > nemu_bench [options]
+    - --filter <text>: Only run the benchmarks whose name contains the text (ex: 'cpu/tick').
+    - --samples <n>: Samples measured per benchmark, 20 by default.
+    - --warmup <seconds>: Warm-up duration of each benchmark, 0.2 by default.
+    - --json <path>: Write the results and every sample as JSON.
+    - --perf <off|on>: Count the host cycles, instructions, branch and cache misses per item with perf_event_open.
+)";
+
+bench::Options parse_options(std::span<const char *> args) {
+  bench::Options options;
+
+  for (size_t n = 0; n < args.size(); n += 2) {
+    std::string_view option = args[n];
+
+    if (n + 1 >= args.size()) {
+      throw Exception {"Missing value for the option '{}'", option};
+    }
+
+    std::string_view value = args[n + 1];
+
+    if (option == "--filter") {
+      options.filter = value;
+    } else if (option == "--samples") {
+      options.samples = std::max(1ul, std::stoul(std::string {value}));
+    } else if (option == "--warmup") {
+      options.warmup = std::stod(std::string {value});
+    } else if (option == "--json") {
+      options.json_path = value;
+    } else if (option == "--perf" && (value == "off" || value == "on")) {
+      options.perf = value == "on";
+    } else {
+      throw Exception {"Invalid option '{} {}'", option, value};
+    }
+  }
+
+  return options;
+}
+
+int main(int argc, const char **argv) {
+  if (argc > 1 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)) {
+    std::cout << CLI_USAGE;
+    return 0;
+  }
+
+  // Dismiss the first argument
+  std::span<const char *> args {argv + 1, argv + argc};
+
+  try {
+    auto options = parse_options(args);
+
+    bench::Suite suite;
+    bench::add_benchmarks(suite);
+
+    auto results = suite.run(options);
+
+    if (options.json_path) {
+      bench::Suite::write_json(*options.json_path, results);
+    }
+  } catch (const std::exception &exception) {
+    std::cerr << "Exception raised: " << exception.what() << std::endl;
+    return 1;
+  } catch (const nemu::Exception &exception) {
+    std::cerr << exception.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
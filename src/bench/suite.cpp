@@ -0,0 +1,203 @@
+#include "suite.hpp"
+#include "exception.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <fstream>
+#include <numeric>
+
+namespace nemu::bench {
+
+using Clock = std::chrono::steady_clock;
+
+void Suite::add(std::string name, std::string unit, Setup setup) {
+  m_benchmarks.push_back({std::move(name), std::move(unit), std::move(setup)});
+}
+
+std::vector<Result> Suite::run(const Options &options) const {
+  std::vector<Result> results;
+
+  fmt::print(
+    "{:<36} {:>12} {:>8} {:>12} {:>12} {:>14}\n",
+    "benchmark",
+    "median",
+    "stddev",
+    "min",
+    "max",
+    "throughput");
+
+  std::optional<PerfCounters> counters;
+
+  if (options.perf && !counters.emplace().available()) {
+    fmt::print("Host counters unavailable, {}\n", counters->error());
+    counters = std::nullopt;
+  }
+
+  for (const Benchmark &benchmark : m_benchmarks) {
+    if (benchmark.name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+
+    print(results.emplace_back(measure(benchmark, options, counters ? &*counters : nullptr)));
+  }
+
+  return results;
+}
+
+Result Suite::measure(const Benchmark &benchmark, const Options &options, PerfCounters *counters) {
+  Iteration iteration = benchmark.setup();
+  Result result {benchmark.name, benchmark.unit, 0, 0, {}, {}, {}, 0};
+
+  // Warm the caches and the branch predictors up, and estimate the duration of an iteration
+  uint64 warmup_iterations = 0;
+  auto begin = Clock::now();
+  std::chrono::duration<f64> elapsed {};
+
+  do {
+    iteration(), warmup_iterations++;
+    elapsed = Clock::now() - begin;
+  } while (elapsed.count() < options.warmup);
+
+  f64 iteration_time = elapsed.count() / warmup_iterations;
+
+  if (counters) {
+    result.counters.emplace();
+  }
+
+  result.iterations = std::max<uint64>(1, std::ceil(options.sample_time / iteration_time));
+
+  for (uint32 n = 0; n < options.samples; n++) {
+    uint64 items = 0;
+
+    // The counters are around the sample, outside of the clock
+    if (counters) {
+      counters->start();
+    }
+
+    auto sample_begin = Clock::now();
+
+    for (uint64 i = 0; i < result.iterations; i++) {
+      items += iteration();
+    }
+
+    std::chrono::duration<f64, std::nano> sample = Clock::now() - sample_begin;
+
+    if (counters) {
+      *result.counters += counters->stop();
+      result.counted_items += items;
+    }
+
+    result.items = items / result.iterations;
+    result.samples.push_back(sample.count() / std::max<uint64>(1, items));
+  }
+
+  auto samples = result.samples;
+  std::ranges::sort(samples);
+
+  f64 size = samples.size();
+  f64 mean = std::accumulate(samples.begin(), samples.end(), f64 {}) / size;
+  f64 variance = std::accumulate(samples.begin(), samples.end(), f64 {}, [&](f64 sum, f64 sample) {
+    return sum + (sample - mean) * (sample - mean);
+  });
+
+  result.statistics = {
+    .min = samples.front(),
+    .max = samples.back(),
+    .mean = mean,
+    .median = samples.size() % 2 ? samples[samples.size() / 2]
+                                 : (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2,
+    .stddev = samples.size() > 1 ? std::sqrt(variance / (size - 1)) : 0,
+  };
+
+  return result;
+}
+
+void Suite::print(const Result &result) {
+  auto [min, max, mean, median, stddev] = result.statistics;
+
+  fmt::print(
+    "{:<36} {:>9.2f} ns {:>7.2f}% {:>9.2f} ns {:>9.2f} ns {:>9.2f}M {}/s\n",
+    result.name,
+    median,
+    stddev / mean * 100,
+    min,
+    max,
+    1e3 / median,
+    result.unit);
+
+  if (!result.counters) {
+    return;
+  }
+
+  // Host events per item, a layout change that cuts misses shows up here before it shows in the time
+  std::string events;
+
+  if (auto ipc = result.counters->ipc()) {
+    events += fmt::format(" ipc {:.3f},", *ipc);
+  }
+
+  for (uint8 n = 0; n < PERF_EVENT_COUNT; n++) {
+    if (auto count = result.counters->events[n]) {
+      events += fmt::format(" {} {:.3f}", PERF_EVENT_NAMES[n], f64(*count) / std::max<uint64>(1, result.counted_items));
+    }
+  }
+
+  fmt::print("{:<36}{} per {}\n", "", events, result.unit);
+}
+
+// Host events per item, null without counters
+static std::string write_counters(const Result &result) {
+  if (!result.counters) {
+    return "null";
+  }
+
+  auto ipc = result.counters->ipc();
+  std::string output = ipc ? fmt::format("{{\"ipc\": {}", *ipc) : "{\"ipc\": null";
+
+  for (uint8 n = 0; n < PERF_EVENT_COUNT; n++) {
+    if (auto count = result.counters->events[n]) {
+      output += fmt::format(", \"{}\": {}", PERF_EVENT_NAMES[n], f64(*count) / std::max<uint64>(1, result.counted_items));
+    }
+  }
+
+  return output + "}";
+}
+
+void Suite::write_json(std::string_view path, const std::vector<Result> &results) {
+  std::ofstream fstream {&path[0]};
+
+  if (!fstream) {
+    throw Exception {"Can't open the JSON output file: '{}'", path};
+  }
+
+  // Names and units are plain identifiers, they never need escaping
+  fstream << "{\n  \"benchmarks\": [";
+
+  for (size_t n = 0; n < results.size(); n++) {
+    const Result &result = results[n];
+    auto [min, max, mean, median, stddev] = result.statistics;
+
+    fstream << fmt::format(
+      "{}\n    {{\"name\": \"{}\", \"unit\": \"{}\", \"iterations\": {}, \"items\": {}, "
+      "\"ns_per_item\": {{\"min\": {}, \"max\": {}, \"mean\": {}, \"median\": {}, \"stddev\": {}}}, "
+      "\"counters\": {}, \"samples\": [{}]}}",
+      n ? "," : "",
+      result.name,
+      result.unit,
+      result.iterations,
+      result.items,
+      min,
+      max,
+      mean,
+      median,
+      stddev,
+      write_counters(result),
+      fmt::join(result.samples, ", "));
+  }
+
+  fstream << "\n  ]\n}\n";
+}
+
+}  // namespace nemu::bench
@@ -0,0 +1,73 @@
+#ifndef NEMU_BENCH_SUITE_HPP
+#define NEMU_BENCH_SUITE_HPP
+
+#include "int.hpp"
+#include "perf_counters.hpp"
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nemu::bench {
+
+// Keep a value alive so the computation producing it is not optimized out
+inline void do_not_optimize(const auto &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs one iteration of a benchmark, returns the count of items processed
+using Iteration = std::function<uint64()>;
+
+// Prepares the state of a benchmark, only called when the benchmark is selected
+using Setup = std::function<Iteration()>;
+
+struct Options {
+  std::string_view filter;
+  uint32 samples = 20;
+  f64 warmup = 0.2, sample_time = 0.02;
+  std::optional<std::string_view> json_path;
+
+  // Count the host events of the samples with perf_event_open
+  bool perf = false;
+};
+
+// Nanoseconds per item across the samples
+struct Statistics {
+  f64 min, max, mean, median, stddev;
+};
+
+struct Result {
+  std::string name, unit;
+  uint64 iterations, items;
+  std::vector<f64> samples;
+  Statistics statistics;
+
+  // Host events of every sample added up, with the count of items they processed
+  std::optional<PerfCounts> counters;
+  uint64 counted_items;
+};
+
+class Suite {
+public:
+  void add(std::string name, std::string unit, Setup setup);
+
+  std::vector<Result> run(const Options &options) const;
+
+  static void print(const Result &result);
+  static void write_json(std::string_view path, const std::vector<Result> &results);
+
+private:
+  struct Benchmark {
+    std::string name, unit;
+    Setup setup;
+  };
+
+  static Result measure(const Benchmark &benchmark, const Options &options, PerfCounters *counters);
+
+  std::vector<Benchmark> m_benchmarks;
+};
+
+}  // namespace nemu::bench
+
+#endif
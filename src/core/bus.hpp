@@ -2,13 +2,17 @@
 #define NEMU_BUS_HPP
 
 #include "cpu/cpu.hpp"
+#include "debugger.hpp"
+#include "profiler.hpp"
 #include <array>
 
 namespace nemu {
 
 class Bus {
 public:
-  Bus() : m_cpu {this} {}
+  Bus() : m_cpu {this} {
+    map_ram();
+  }
 
   virtual void init() = 0;
   virtual void tick() = 0;
@@ -17,6 +21,69 @@ public:
   virtual uint8 cpu_peek(uint16 n) const = 0;
   virtual uint8 cpu_read(uint16 n) = 0;
 
+  // Checked before the uncached instructions run, true to stop before the instruction
+  inline bool breakpoint(uint16 pc) {
+    return (m_debugger.hit() || m_debugger.flags(DebugSpace::CPU, pc) & DEBUG_EXECUTE) && debug_break(pc);
+  }
+
+  virtual bool debug_break(uint16) {
+    return false;
+  }
+
+#ifdef NEMU_TRACE
+  // Called before every instruction executes, only compiled in trace builds
+  virtual void trace(const cpu::Decoded &) {}
+#endif
+
+#ifdef NEMU_PROFILE
+  // Count the accesses into the profiler, null to stop profiling, only compiled in profile builds
+  inline void set_profiler(Profiler *profiler) {
+    m_profiler = profiler;
+  }
+
+  inline void profile(uint16 n, ProfileAccess access) {
+    if (m_profiler) {
+      m_profiler->cpu(n, prg_bank(n), access);
+    }
+  }
+
+  inline void profile_ppu(uint16 n, ProfileAccess access) {
+    if (m_profiler) {
+      m_profiler->ppu(n, access);
+    }
+  }
+#endif
+
+  // Access the memory mapped at the page directly, or go through the handlers when it is not mapped
+  inline uint8 read(uint16 n) {
+#ifdef NEMU_PROFILE
+    profile(n, PROFILE_READ);
+#endif
+
+    const uint8 *page = m_read_pages[n >> 8];
+    return page ? page[n & 0xFF] : cpu_read(n);
+  }
+
+  inline uint8 write(uint16 n, uint8 data) {
+#ifdef NEMU_PROFILE
+    profile(n, PROFILE_WRITE);
+#endif
+
+    uint8 *page = m_write_pages[n >> 8];
+    return page ? page[n & 0xFF] = data : cpu_write(n, data);
+  }
+
+  // Instruction fetches are not data reads, they don't trigger the watchpoints
+  inline uint8 fetch(uint16 n) {
+    const uint8 *page = m_read_pages[n >> 8];
+
+    if (page) {
+      return page[n & 0xFF];
+    }
+
+    return m_debugger.flags(DebugSpace::CPU, n) & DEBUG_READ ? cpu_peek(n) : cpu_read(n);
+  }
+
   inline const auto &ram() const {
     return m_ram;
   }
@@ -29,13 +96,40 @@ public:
     return m_ram;
   }
 
+  // PRG bank tag of the 8KB window holding the address, zero when the window is not PRG memory
+  inline uint32 prg_bank(uint16 n) const {
+    return m_prg_banks[n >> 13];
+  }
+
   inline Cpu &cpu() {
     return m_cpu;
   }
 
+  inline const Debugger &debugger() const {
+    return m_debugger;
+  }
+
 protected:
+  inline void map_ram() {
+    // The 2KB of RAM are mirrored up to 0x1FFF
+    for (uint16 page = 0x00; page < 0x20; page++) {
+      m_read_pages[page] = m_write_pages[page] = &m_ram[(page & 0x07) << 8];
+    }
+  }
+
+
   Cpu m_cpu;
   std::array<uint8, 2048> m_ram;
+  std::array<uint32, 8> m_prg_banks {};
+
+  // Direct pointers to the 256 bytes pages of the CPU address space, null for the pages with side effects
+  std::array<uint8 *, 0x100> m_read_pages {}, m_write_pages {};
+
+  Debugger m_debugger;
+
+#ifdef NEMU_PROFILE
+  Profiler *m_profiler {};
+#endif
 };
 
 }  // namespace nemu
@@ -1,16 +1,17 @@
 #include "cpu.hpp"
 #include "bus.hpp"
 #include "exception.hpp"
-#include <optional>
+#include <algorithm>
 
 namespace nemu {
 
 using namespace cpu;
 
-Cpu::Cpu(Bus *bus) : Hardware {bus} {}
+Cpu::Cpu(Bus *bus) : Hardware {bus}, m_cache(0x10000) {}
 
 void Cpu::init() {
   m_bus.ram() = {}, m_cycles_remaining = 0, m_instruction_counter = 0;
+  std::ranges::fill(m_cache, Decoded {});
 
   m_regs = Registers {
     .status = {},
@@ -26,10 +27,7 @@ void Cpu::init() {
 
 void Cpu::tick() {
   if (m_cycles_remaining-- < 1) {
-    uint8 opcode = m_bus.cpu_read(m_regs.pc++);
-    auto instruction = INSTRUCTION_SET[opcode];
-    parse_instruction(instruction);
-    m_instruction_counter++;
+    execute(decode(m_regs.pc));
   }
 }
 
@@ -43,6 +41,31 @@ void Cpu::nmi() {
   m_regs.pc = interrupt(CPU_NMI, m_regs.pc);
 }
 
+void Cpu::invalidate(uint16 n) {
+  // An instruction is at most 3 bytes long, the write may hit its opcode or operands
+  for (uint16 offset = 0; offset < Instruction::max_size(); offset++) {
+    m_cache[uint16(n - offset)].bank = 0;
+  }
+}
+
+void Cpu::invalidate(uint16 begin, uint16 end) {
+  for (uint32 n = uint16(begin - Instruction::max_size() + 1); n <= end; n++) {
+    m_cache[n].bank = 0;
+  }
+}
+
+void Cpu::save(StateWriter &state) const {
+  state.write(m_regs);
+  state.write(m_cycles_remaining);
+  state.write(m_instruction_counter);
+}
+
+void Cpu::load(StateReader &state) {
+  state.read(m_regs);
+  state.read(m_cycles_remaining);
+  state.read(m_instruction_counter);
+}
+
 uint16 Cpu::interrupt(Interrupt interrupt, uint16 pc) {
   m_regs.status.b = 1;
 
@@ -58,126 +81,181 @@ uint16 Cpu::interrupt(Interrupt interrupt, uint16 pc) {
   m_cycles_remaining += interrupt.cycles;
   m_regs.status.bits |= interrupt.status_mask;
 
-  return m_bus.cpu_read(interrupt.vector + 1) << 8 | m_bus.cpu_read(interrupt.vector);
+  return m_bus.read(interrupt.vector + 1) << 8 | m_bus.read(interrupt.vector);
 }
 
-void Cpu::parse_instruction(Instruction instruction) {
-  if (instruction.mode & ACC) {
-    auto output = execute_operation(instruction, m_regs.a);
+const Decoded &Cpu::decode(uint16 pc) {
+  uint32 bank = m_bus.prg_bank(pc);
+  Decoded *decoded = &m_uncached;
 
-    if (output.has_value()) {
-      m_regs.a = output.value();
+  if (bank != 0) {
+    decoded = &m_cache[pc];
+
+    if (decoded->bank == bank) {
+      return *decoded;
     }
+  }
 
-    // TODO: update when available:
-    // execute_operation(instruction, m_regs.a).and_then([&](uint8 output) {
-    //   m_regs.a = output;
-    // });
+  // Instructions of the pages with an execution breakpoint are never cached, nor fetched once a watchpoint is hit
+  if (m_bus.breakpoint(pc)) [[unlikely]] {
+    // Ready to run the instruction once resumed
+    m_cycles_remaining++;
+    throw DebugBreak {};
   }
 
-  if (instruction.mode & IMM) {
-    execute_operation(instruction, m_bus.cpu_read(m_regs.pc++));
+  uint8 opcode = m_bus.fetch(pc);
+  const Instruction &instruction = INSTRUCTION_SET[opcode];
+  uint8 size = instruction.size();
+
+  *decoded = {HANDLERS[opcode], opcode, {}, size, instruction.cycles, 0};
+
+  for (uint8 n = 1; n < size; n++) {
+    decoded->operands[n - 1] = m_bus.fetch(pc + n);
   }
 
-  if (instruction.mode & IMP) {
-    execute_operation(instruction, {});
+  // Instructions overlapping two PRG windows can't be tagged with a single bank, and the ones of the
+  // pages with an execution breakpoint are left uncached to be checked every time they run
+  bool breakpoint = m_bus.debugger().flags(DebugSpace::CPU, pc) & DEBUG_EXECUTE;
+
+  if (bank != 0 && uint16(pc + size - 1) >> 13 == pc >> 13 && !breakpoint) {
+    decoded->bank = static_cast<uint16>(bank);
   }
 
-  if (instruction.mode & REL) {
-    uint16 offset = m_bus.cpu_read(m_regs.pc++);
+  return *decoded;
+}
+
+void Cpu::execute(const Decoded &decoded) {
+#ifdef NEMU_TRACE
+  m_bus.trace(decoded);
+#endif
 
-    if (offset & 0x80) {
-      offset |= 0xFF00;
-    }
+#ifdef NEMU_PROFILE
+  m_bus.profile(m_regs.pc, PROFILE_EXECUTE);
+#endif
+
+  m_regs.pc += decoded.size;
+  (*decoded.handler)(*this, decoded);
+  m_instruction_counter++;
+}
+
+template<size_t... N>
+constexpr auto Cpu::make_handlers(std::index_sequence<N...>) -> std::array<Handler, sizeof...(N)> {
+  return {&Cpu::execute_opcode<N>...};
+}
+
+const std::array<Handler, 256> Cpu::HANDLERS = make_handlers(std::make_index_sequence<256> {});
+
+template<uint8 OPCODE>
+void Cpu::execute_opcode(Cpu &cpu, const Decoded &decoded) {
+  constexpr Instruction INSTRUCTION = INSTRUCTION_SET[OPCODE];
+  constexpr Mnemonic MNEMONIC = INSTRUCTION.mnemonic;
+  constexpr Mode MODE = INSTRUCTION.mode;
+
+  auto &regs = cpu.m_regs;
+  auto &bus = cpu.m_bus;
 
-    execute_operation(instruction, offset);
+  if constexpr (MODE == ACC) {
+    regs.a = cpu.execute_operation<MNEMONIC>(regs.a);
   }
 
-  if (instruction.mode & MEMORY) {
-    uint16 address = parse_address(instruction);
+  else if constexpr (MODE == IMM || MODE == REL) {
+    cpu.execute_operation<MNEMONIC>(decoded.operands[0]);
+  }
 
-    if (instruction.mnemonic & JUMP) {
-      execute_operation(instruction, address);
-    }
+  else if constexpr (MODE == IMP) {
+    cpu.execute_operation<MNEMONIC>({});
+  }
 
-    else if (instruction.mnemonic & STORE) {
-      m_bus.cpu_write(address, *execute_operation(instruction, {}));
+  else {
+    uint16 address = cpu.parse_address<MODE>(decoded);
+
+    if constexpr ((MNEMONIC & JUMP) != 0) {
+      cpu.execute_operation<MNEMONIC>(address);
     }
 
-    else {
-      auto output = execute_operation(instruction, m_bus.cpu_read(address));
+    else if constexpr ((MNEMONIC & STORE) != 0) {
+      bus.write(address, cpu.execute_operation<MNEMONIC>({}));
+    }
 
-      if (output.has_value()) {
-        m_bus.cpu_write(address, *output);
-      }
+    // Read-modify-write instructions write back their output
+    else if constexpr ((MNEMONIC & (SHIFT | INC | DEC)) != 0) {
+      bus.write(address, cpu.execute_operation<MNEMONIC>(bus.read(address)));
+    }
 
-      // TODO: update when available:
-      // execute_operation(instruction, m_bus.cpu_read(address)).and_then([&](uint8 output) {
-      //   m_bus.cpu_write(address, output);
-      // });
+    else {
+      cpu.execute_operation<MNEMONIC>(bus.read(address));
     }
   }
 
-  m_cycles_remaining += instruction.cycles;
+  cpu.m_cycles_remaining += decoded.cycles;
 }
 
-uint16 Cpu::parse_address(Instruction instruction) {
-  const auto absolute = [&](uint8 offset) -> uint16 {
-    uint8 address_bytes[] = {
-      m_bus.cpu_read(m_regs.pc++),
-      m_bus.cpu_read(m_regs.pc++),
-    };
+template<Mode MODE>
+uint16 Cpu::parse_address(const Decoded &decoded) {
+  const uint8 *operands = decoded.operands;
 
-    return (address_bytes[1] << 8 | address_bytes[0]) + offset;
+  const auto absolute = [&](uint8 offset) -> uint16 {
+    return (operands[1] << 8 | operands[0]) + offset;
   };
 
   const auto zero_page = [&](uint8 offset) -> uint8 {
-    return (m_bus.cpu_read(m_regs.pc++) + offset) & 0xFF;
+    return (operands[0] + offset) & 0xFF;
   };
 
-  switch (instruction.mode) {
-  case ABS: return absolute({});
-  case ABX: return absolute(m_regs.x);
-  case ABY: return absolute(m_regs.y);
+  if constexpr (MODE == ABS) {
+    return absolute({});
+  }
 
-  case ZER: return zero_page({});
-  case ZPX: return zero_page(m_regs.x);
-  case ZPY: return zero_page(m_regs.y);
+  if constexpr (MODE == ABX) {
+    return absolute(m_regs.x);
+  }
 
-  case IND: {
-    uint8 address_bytes[] = {
-      m_bus.cpu_read(m_regs.pc++),
-      m_bus.cpu_read(m_regs.pc++),
-    };
+  if constexpr (MODE == ABY) {
+    return absolute(m_regs.y);
+  }
+
+  if constexpr (MODE == ZER) {
+    return zero_page({});
+  }
+
+  if constexpr (MODE == ZPX) {
+    return zero_page(m_regs.x);
+  }
 
+  if constexpr (MODE == ZPY) {
+    return zero_page(m_regs.y);
+  }
+
+  if constexpr (MODE == IND) {
+    const uint8 *address_bytes = operands;
     uint16 address = (address_bytes[1] << 8) | address_bytes[0];
 
     uint8 destination_bytes[] = {
-      m_bus.cpu_read(address),
+      m_bus.read(address),
       // 6502 page boundary bug emulation
-      address_bytes[0] != 0xFF ? m_bus.cpu_read(address + 1) : m_bus.cpu_read(address & 0xFF00),
+      address_bytes[0] != 0xFF ? m_bus.read(address + 1) : m_bus.read(address & 0xFF00),
     };
 
     return destination_bytes[1] << 8 | destination_bytes[0];
   }
 
-  case IDX: {
-    uint8 address = m_bus.cpu_read(m_regs.pc++) + m_regs.x;
+  if constexpr (MODE == IDX) {
+    uint8 address = operands[0] + m_regs.x;
 
     uint8 destination_bytes[] = {
-      m_bus.cpu_read(address++ & 0xFF),
-      m_bus.cpu_read(address++ & 0xFF),
+      m_bus.read(address++ & 0xFF),
+      m_bus.read(address++ & 0xFF),
     };
 
     return destination_bytes[1] << 8 | destination_bytes[0];
   }
 
-  case IDY: {
-    uint8 address = m_bus.cpu_read(m_regs.pc++);
+  if constexpr (MODE == IDY) {
+    uint8 address = operands[0];
 
     uint8 address_bytes[] = {
-      m_bus.cpu_read(address++ & 0xFF),
-      m_bus.cpu_read(address++ & 0xFF),
+      m_bus.read(address++ & 0xFF),
+      m_bus.read(address++ & 0xFF),
     };
 
     uint16 destination = (address_bytes[1] << 8 | address_bytes[0]) + m_regs.y;
@@ -188,24 +266,21 @@ uint16 Cpu::parse_address(Instruction instruction) {
 
     return destination;
   }
-
-  default: return {};
-  }
 }
 
-auto Cpu::execute_operation(Instruction instruction, uint16 operand) -> std::optional<uint8> {
-  switch (instruction.mnemonic) {
-  case ADC: {
+template<Mnemonic MNEMONIC>
+uint8 Cpu::execute_operation(uint16 operand) {
+  if constexpr (MNEMONIC == ADC) {
     m_regs.a = add_with_carry(operand);
-  } break;
+  }
 
-  case AND: {
+  else if constexpr (MNEMONIC == AND) {
     m_regs.a = bitwise_fn(operand, [](uint8 a, uint8 b) -> uint8 {
       return a & b;
     });
-  } break;
+  }
 
-  case ASL: {
+  else if constexpr (MNEMONIC == ASL) {
     uint8 output = operand << 1;
 
     m_regs.status.c = operand & 0x80;
@@ -215,130 +290,130 @@ auto Cpu::execute_operation(Instruction instruction, uint16 operand) -> std::opt
     return output;
   }
 
-  case BCC: {
+  else if constexpr (MNEMONIC == BCC) {
     branch(!m_regs.status.c, operand);
-  } break;
+  }
 
-  case BCS: {
+  else if constexpr (MNEMONIC == BCS) {
     branch(m_regs.status.c, operand);
-  } break;
+  }
 
-  case BEQ: {
+  else if constexpr (MNEMONIC == BEQ) {
     branch(m_regs.status.z, operand);
-  } break;
+  }
 
-  case BIT: {
+  else if constexpr (MNEMONIC == BIT) {
     m_regs.status.n = operand & 0x80;
     m_regs.status.v = operand & 0x40;
     m_regs.status.z = !(m_regs.a & operand);
-  } break;
+  }
 
-  case BMI: {
+  else if constexpr (MNEMONIC == BMI) {
     branch(m_regs.status.n, operand);
-  } break;
+  }
 
-  case BNE: {
+  else if constexpr (MNEMONIC == BNE) {
     branch(!m_regs.status.z, operand);
-  } break;
+  }
 
-  case BPL: {
+  else if constexpr (MNEMONIC == BPL) {
     branch(!m_regs.status.n, operand);
-  } break;
+  }
 
-  case BRK: {
+  else if constexpr (MNEMONIC == BRK) {
     m_regs.pc = interrupt(CPU_BRK, m_regs.pc + 1);
-  } break;
+  }
 
-  case BVC: {
+  else if constexpr (MNEMONIC == BVC) {
     branch(!m_regs.status.v, operand);
-  } break;
+  }
 
-  case BVS: {
+  else if constexpr (MNEMONIC == BVS) {
     branch(m_regs.status.v, operand);
-  } break;
+  }
 
-  case CLC: {
+  else if constexpr (MNEMONIC == CLC) {
     m_regs.status.c = 0;
-  } break;
+  }
 
-  case CLD: {
+  else if constexpr (MNEMONIC == CLD) {
     m_regs.status.d = 0;
-  } break;
+  }
 
-  case CLI: {
+  else if constexpr (MNEMONIC == CLI) {
     m_regs.status.i = 0;
-  } break;
+  }
 
-  case CLV: {
+  else if constexpr (MNEMONIC == CLV) {
     m_regs.status.v = 0;
-  } break;
+  }
 
-  case CMP: {
+  else if constexpr (MNEMONIC == CMP) {
     compare(m_regs.a, operand);
-  } break;
+  }
 
-  case CPX: {
+  else if constexpr (MNEMONIC == CPX) {
     compare(m_regs.x, operand);
-  } break;
+  }
 
-  case CPY: {
+  else if constexpr (MNEMONIC == CPY) {
     compare(m_regs.y, operand);
-  } break;
+  }
 
-  case DEC: {
+  else if constexpr (MNEMONIC == DEC) {
     return parse_operand((operand - 1) % 256);
   }
 
-  case DEX: {
+  else if constexpr (MNEMONIC == DEX) {
     m_regs.x = parse_operand((m_regs.x - 1) % 256);
-  } break;
+  }
 
-  case DEY: {
+  else if constexpr (MNEMONIC == DEY) {
     m_regs.y = parse_operand((m_regs.y - 1) % 256);
-  } break;
+  }
 
-  case EOR: {
+  else if constexpr (MNEMONIC == EOR) {
     m_regs.a = bitwise_fn(operand, [](uint8 a, uint8 b) -> uint8 {
       return a ^ b;
     });
-  } break;
+  }
 
-  case INC: {
+  else if constexpr (MNEMONIC == INC) {
     return parse_operand((operand + 1) % 256);
   }
 
-  case INX: {
+  else if constexpr (MNEMONIC == INX) {
     m_regs.x = parse_operand((m_regs.x + 1) % 256);
-  } break;
+  }
 
-  case INY: {
+  else if constexpr (MNEMONIC == INY) {
     m_regs.y = parse_operand((m_regs.y + 1) % 256);
-  } break;
+  }
 
-  case JMP: {
+  else if constexpr (MNEMONIC == JMP) {
     m_regs.pc = operand;
-  } break;
+  }
 
-  case JSR: {
+  else if constexpr (MNEMONIC == JSR) {
     stack_push((m_regs.pc - 1) >> 8);
     stack_push((m_regs.pc - 1) & 0xFF);
 
     m_regs.pc = operand;
-  } break;
+  }
 
-  case LDA: {
+  else if constexpr (MNEMONIC == LDA) {
     m_regs.a = parse_operand(operand);
-  } break;
+  }
 
-  case LDX: {
+  else if constexpr (MNEMONIC == LDX) {
     m_regs.x = parse_operand(operand);
-  } break;
+  }
 
-  case LDY: {
+  else if constexpr (MNEMONIC == LDY) {
     m_regs.y = parse_operand(operand);
-  } break;
+  }
 
-  case LSR: {
+  else if constexpr (MNEMONIC == LSR) {
     uint8 output = operand >> 1;
 
     m_regs.status.c = operand & 0x01;
@@ -348,29 +423,29 @@ auto Cpu::execute_operation(Instruction instruction, uint16 operand) -> std::opt
     return output;
   }
 
-  case ORA: {
+  else if constexpr (MNEMONIC == ORA) {
     m_regs.a = bitwise_fn(operand, [](uint8 a, uint8 b) -> uint8 {
       return a | b;
     });
-  } break;
+  }
 
-  case PHA: {
+  else if constexpr (MNEMONIC == PHA) {
     stack_push(m_regs.a);
-  } break;
+  }
 
-  case PHP: {
+  else if constexpr (MNEMONIC == PHP) {
     stack_push(m_regs.status.bits | (0b0011'0000));
-  } break;
+  }
 
-  case PLA: {
+  else if constexpr (MNEMONIC == PLA) {
     m_regs.a = parse_operand(stack_pop());
-  } break;
+  }
 
-  case PLP: {
+  else if constexpr (MNEMONIC == PLP) {
     m_regs.status.bits = stack_pop() | (m_regs.status.bits & 0b0011'0000);
-  } break;
+  }
 
-  case ROL: {
+  else if constexpr (MNEMONIC == ROL) {
     uint16 output = (operand << 1) | m_regs.status.c;
 
     m_regs.status.c = output > 0xFF;
@@ -380,7 +455,7 @@ auto Cpu::execute_operation(Instruction instruction, uint16 operand) -> std::opt
     return output & 0xFF;
   }
 
-  case ROR: {
+  else if constexpr (MNEMONIC == ROR) {
     uint16 output = (operand >> 1) | (m_regs.status.c << 7);
 
     m_regs.status.c = operand & 0x01;
@@ -390,78 +465,75 @@ auto Cpu::execute_operation(Instruction instruction, uint16 operand) -> std::opt
     return output & 0xFF;
   }
 
-  case RTI: {
+  else if constexpr (MNEMONIC == RTI) {
     m_regs.status.bits = stack_pop();
     m_regs.status.b = 0;
     m_regs.status._ = 1;
 
     m_regs.pc = ((stack_pop()) | (stack_pop() << 8));
-  } break;
+  }
 
-  case RTS: {
+  else if constexpr (MNEMONIC == RTS) {
     m_regs.pc = ((stack_pop()) | (stack_pop() << 8)) + 1;
-  } break;
+  }
 
-  case SBC: {
+  else if constexpr (MNEMONIC == SBC) {
     m_regs.a = add_with_carry(~operand);
-  } break;
+  }
 
-  case SEC: {
+  else if constexpr (MNEMONIC == SEC) {
     m_regs.status.c = 1;
-  } break;
+  }
 
-  case SED: {
+  else if constexpr (MNEMONIC == SED) {
     m_regs.status.d = 1;
-  } break;
+  }
 
-  case SEI: {
+  else if constexpr (MNEMONIC == SEI) {
     m_regs.status.i = 1;
-  } break;
+  }
 
-  case STA: {
+  else if constexpr (MNEMONIC == STA) {
     return m_regs.a;
   }
 
-  case STX: {
+  else if constexpr (MNEMONIC == STX) {
     return m_regs.x;
   }
 
-  case STY: {
+  else if constexpr (MNEMONIC == STY) {
     return m_regs.y;
   }
 
-  case TAX: {
+  else if constexpr (MNEMONIC == TAX) {
     m_regs.x = parse_operand(m_regs.a);
-  } break;
+  }
 
-  case TAY: {
+  else if constexpr (MNEMONIC == TAY) {
     m_regs.y = parse_operand(m_regs.a);
-  } break;
+  }
 
-  case TSX: {
+  else if constexpr (MNEMONIC == TSX) {
     m_regs.x = parse_operand(m_regs.sp);
-  } break;
+  }
 
-  case TXA: {
+  else if constexpr (MNEMONIC == TXA) {
     m_regs.a = parse_operand(m_regs.x);
-  } break;
+  }
 
-  case TXS: {
+  else if constexpr (MNEMONIC == TXS) {
     m_regs.sp = m_regs.x;
-  } break;
+  }
 
-  case TYA: {
+  else if constexpr (MNEMONIC == TYA) {
     m_regs.a = parse_operand(m_regs.y);
-  } break;
+  }
 
-  case ILL: {
+  else if constexpr (MNEMONIC == ILL) {
     // throw Exception {"CPU does not implement ILL opcodes (ALR, TAS, SHX, ...)"};
-  } break;
-
-  default: break;
   }
 
-  return std::nullopt;
+  return {};
 }
 
 uint8 Cpu::parse_operand(uint8 operand) {
@@ -513,11 +585,11 @@ void Cpu::compare(uint8 a, uint8 b) {
 }
 
 uint8 Cpu::stack_push(uint8 data) {
-  return m_bus.cpu_write(0x0100 + m_regs.sp--, data);
+  return m_bus.write(0x0100 + m_regs.sp--, data);
 }
 
 uint8 Cpu::stack_pop() {
-  return m_bus.cpu_read(0x0100 + ++m_regs.sp);
+  return m_bus.read(0x0100 + ++m_regs.sp);
 }
 
 }  // namespace nemu
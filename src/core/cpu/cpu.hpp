@@ -1,11 +1,15 @@
 #ifndef NEMU_CPU_HPP
 #define NEMU_CPU_HPP
 
+#include "decoded.hpp"
 #include "hardware.hpp"
 #include "instructions.hpp"
 #include "interrupt.hpp"
 #include "registers.hpp"
-#include <optional>
+#include "state.hpp"
+#include <array>
+#include <utility>
+#include <vector>
 
 namespace nemu {
 
@@ -21,10 +25,28 @@ public:
   void irq();
   void nmi();
 
+  // Let cycles pass without reaching the next instruction
+  inline void idle(uint32 cycles) {
+    m_cycles_remaining -= cycles;
+  }
+
+  // Drop the cached instructions overlapping the written address
+  void invalidate(uint16 n);
+
+  // Drop the cached instructions overlapping a whole range of memory below PRG-ROM
+  void invalidate(uint16 begin, uint16 end);
+
+  void save(StateWriter &state) const;
+  void load(StateReader &state);
+
   inline const auto &registers() const {
     return m_regs;
   }
 
+  inline void set_registers(const cpu::Registers &registers) {
+    m_regs = registers;
+  }
+
   inline uint32 cycles_remaining() const {
     return m_cycles_remaining;
   }
@@ -44,9 +66,23 @@ public:
 private:
   uint16 interrupt(Interrupt interrupt, uint16 pc);
 
-  void parse_instruction(cpu::Instruction instruction);
-  uint16 parse_address(cpu::Instruction instruction);
-  auto execute_operation(cpu::Instruction instruction, uint16 operand) -> std::optional<uint8>;
+  // Throws a DebugBreak to stop before an instruction at a breakpoint
+  const cpu::Decoded &decode(uint16 pc);
+
+  void execute(const cpu::Decoded &decoded);
+
+  template<size_t... N>
+  constexpr static auto make_handlers(std::index_sequence<N...>)
+    -> std::array<cpu::Handler, sizeof...(N)>;
+
+  template<uint8 OPCODE>
+  static void execute_opcode(Cpu &cpu, const cpu::Decoded &decoded);
+
+  template<cpu::Mode MODE>
+  uint16 parse_address(const cpu::Decoded &decoded);
+
+  template<cpu::Mnemonic MNEMONIC>
+  uint8 execute_operation(uint16 operand);
 
   uint8 parse_operand(uint8 operand);
   uint8 add_with_carry(uint8 operand);
@@ -57,9 +93,15 @@ private:
   uint8 stack_push(uint8 data);
   uint8 stack_pop();
 
+  // Handlers of the instruction set indexed by opcode
+  static const std::array<cpu::Handler, 256> HANDLERS;
+
   cpu::Registers m_regs;
   uint32 m_cycles_remaining;
   uint32 m_instruction_counter;
+
+  std::vector<cpu::Decoded> m_cache;
+  cpu::Decoded m_uncached;
 };
 
 }  // namespace nemu
@@ -0,0 +1,36 @@
+#ifndef NEMU_CPU_DECODED_HPP
+#define NEMU_CPU_DECODED_HPP
+
+#include "instructions.hpp"
+
+namespace nemu {
+class Cpu;
+}
+
+namespace nemu::cpu {
+
+struct Decoded;
+
+// Execute a decoded instruction, specialized for each opcode of the instruction set
+using Handler = void (*)(Cpu &cpu, const Decoded &decoded);
+
+// Instruction predecoded at a given address, the operands are fetched once and reused until
+// the bank mapped at this address changes or the memory is written
+struct Decoded {
+  Handler handler {};
+  uint8 opcode {};
+  uint8 operands[2] {};
+  uint8 size {};
+  uint8 cycles {};
+
+  // PRG bank tag the instruction was decoded from, zero when the entry is not cached
+  uint16 bank {};
+
+  constexpr const Instruction &instruction() const {
+    return INSTRUCTION_SET[opcode];
+  }
+};
+
+}  // namespace nemu::cpu
+
+#endif
@@ -6,15 +6,31 @@
 #include "misc.hpp"
 #include "registers.hpp"
 #include <algorithm>
+#include <array>
 #include <charconv>
 #include <fmt/format.h>
-#include <vector>
 
 namespace nemu::cpu {
 
 struct Disasm {
-  struct Bytes : std::vector<uint8> {
-    using vector::vector;
+  // Stored inline, an instruction is at most 3 bytes and a disassembly must not allocate
+  struct Bytes {
+    Bytes(size_t size = 0) : count {uint8(size)} {}
+
+    inline size_t size() const {
+      return count;
+    }
+
+    inline uint8 &operator[](size_t n) {
+      return data[n];
+    }
+
+    inline uint8 operator[](size_t n) const {
+      return data[n];
+    }
+
+    std::array<uint8, Instruction::max_size()> data {};
+    uint8 count;
   };
 
   struct Fetch {
@@ -26,14 +26,14 @@ struct Instruction {
     case REL:
     case ZER:
     case ZPX:
-    case ZPY: return 2;
+    case ZPY:
+    case IDX:
+    case IDY: return 2;
 
     case ABS:
     case ABX:
     case ABY:
-    case IND:
-    case IDX:
-    case IDY: return 3;
+    case IND: return 3;
 
     default: return {};
     }
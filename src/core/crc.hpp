@@ -0,0 +1,39 @@
+#ifndef NEMU_CRC_HPP
+#define NEMU_CRC_HPP
+
+#include "int.hpp"
+#include <array>
+#include <span>
+
+namespace nemu {
+
+constexpr auto CRC_TABLE = [] {
+  std::array<uint32, 256> table {};
+
+  for (uint32 n = 0; n < table.size(); n++) {
+    uint32 crc = n;
+
+    for (uint8 bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+    }
+
+    table[n] = crc;
+  }
+
+  return table;
+}();
+
+// CRC-32 (IEEE), chained through the previous value
+inline uint32 crc32(std::span<const uint8> data, uint32 crc = 0) {
+  crc = ~crc;
+
+  for (uint8 byte : data) {
+    crc = CRC_TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+}  // namespace nemu
+
+#endif
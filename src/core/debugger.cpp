@@ -0,0 +1,161 @@
+#include "debugger.hpp"
+#include "cpu/cpu.hpp"
+#include <algorithm>
+#include <span>
+
+namespace nemu {
+
+static uint8 register_value(const Cpu &cpu, DebugRegister reg) {
+  const auto &regs = cpu.registers();
+
+  switch (reg) {
+  case DebugRegister::A: return regs.a;
+  case DebugRegister::X: return regs.x;
+  case DebugRegister::Y: return regs.y;
+  case DebugRegister::P: return regs.status.bits;
+  case DebugRegister::SP: return regs.sp;
+  }
+
+  return {};
+}
+
+// The RAM and the PPU registers are mirrored below $4000, the CPU reaches them through any mirror
+struct CpuMirror {
+  uint32 begin, end, stride;
+};
+
+constexpr CpuMirror CPU_MIRRORS[] = {{0x0000, 0x1FFF, 0x800}, {0x2000, 0x3FFF, 0x8}};
+
+static bool in_range(const Breakpoint &breakpoint, uint16 n) {
+  if (n >= breakpoint.begin && n <= breakpoint.end) {
+    return true;
+  }
+
+  if (breakpoint.space != DebugSpace::CPU) {
+    return false;
+  }
+
+  for (const auto &mirror : CPU_MIRRORS) {
+    uint32 first = std::max<uint32>(breakpoint.begin, mirror.begin), last = std::min<uint32>(breakpoint.end, mirror.end);
+
+    if (n < mirror.begin || n > mirror.end || first > last) {
+      continue;
+    }
+
+    // First address of the range with the same offset in the mirror as the access
+    return first + (n % mirror.stride + mirror.stride - first % mirror.stride) % mirror.stride <= last;
+  }
+
+  return false;
+}
+
+uint32 Debugger::add(const Breakpoint &breakpoint) {
+  m_breakpoints.emplace_back(m_next_id, breakpoint);
+  map_pages();
+
+  return m_next_id++;
+}
+
+bool Debugger::remove(uint32 id) {
+  if (std::erase_if(m_breakpoints, [id](const auto &entry) { return entry.first == id; }) == 0) {
+    return false;
+  }
+
+  map_pages();
+  return true;
+}
+
+void Debugger::clear() {
+  m_breakpoints.clear(), m_hit = std::nullopt, m_skip = std::nullopt;
+  map_pages();
+}
+
+bool Debugger::check(DebugSpace space, uint16 n, DebugAccess access, const Cpu &cpu, uint64 cycle) {
+  // Resuming steps over the instruction the console stopped at
+  if (access == DEBUG_EXECUTE && m_skip) {
+    bool skip = *m_skip == n;
+    m_skip = std::nullopt;
+
+    if (skip) {
+      return false;
+    }
+  }
+
+  for (const auto &[id, breakpoint] : m_breakpoints) {
+    if (breakpoint.space != space || !(breakpoint.access & access) || !in_range(breakpoint, n)) {
+      continue;
+    }
+
+    if (const auto &condition = breakpoint.condition) {
+      if ((register_value(cpu, condition->reg) & condition->mask) != condition->value) {
+        continue;
+      }
+    }
+
+    if (!m_hit) {
+      m_hit = DebugHit {id, space, access, n, cpu.program_counter(), cycle};
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+void Debugger::resume() {
+  if (m_hit && m_hit->access == DEBUG_EXECUTE) {
+    m_skip = m_hit->address;
+  }
+
+  m_hit = std::nullopt;
+}
+
+void Debugger::map_pages() {
+  m_cpu_pages = {}, m_ppu_pages = {}, m_watching = false;
+
+  for (const auto &[_, breakpoint] : m_breakpoints) {
+    bool cpu = breakpoint.space == DebugSpace::CPU;
+    std::span<uint8> pages = cpu ? std::span<uint8> {m_cpu_pages} : std::span<uint8> {m_ppu_pages};
+
+    auto map = [&](uint32 first, uint32 last) {
+      for (uint32 page = first >> 8; page <= last >> 8; page++) {
+        pages[page] |= breakpoint.access;
+      }
+    };
+
+    if (!cpu) {
+      map(breakpoint.begin & 0x3FFF, breakpoint.end & 0x3FFF);
+      continue;
+    }
+
+    map(breakpoint.begin, breakpoint.end);
+
+    // The pages of every mirror of the addresses covered are checked as well
+    for (const auto &mirror : CPU_MIRRORS) {
+      uint32 first = std::max<uint32>(breakpoint.begin, mirror.begin), last = std::min<uint32>(breakpoint.end, mirror.end);
+
+      if (first > last) {
+        continue;
+      }
+
+      if (last - first + 1 >= mirror.stride) {
+        map(mirror.begin, mirror.end);
+        continue;
+      }
+
+      for (uint32 base = mirror.begin; base < mirror.end; base += mirror.stride) {
+        uint32 begin = base + first % mirror.stride, end = base + last % mirror.stride;
+
+        if (begin <= end) {
+          map(begin, end);
+        } else {
+          map(base, end), map(begin, base + mirror.stride - 1);
+        }
+      }
+    }
+
+    m_watching |= breakpoint.access & (DEBUG_READ | DEBUG_WRITE);
+  }
+}
+
+}  // namespace nemu
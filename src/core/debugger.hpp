@@ -0,0 +1,96 @@
+#ifndef NEMU_DEBUGGER_HPP
+#define NEMU_DEBUGGER_HPP
+
+#include "int.hpp"
+#include <array>
+#include <optional>
+#include <vector>
+
+namespace nemu {
+
+class Cpu;
+
+enum DebugAccess : uint8 {
+  DEBUG_EXECUTE = 1 << 0,
+  DEBUG_READ = 1 << 1,
+  DEBUG_WRITE = 1 << 2,
+};
+
+enum class DebugSpace : uint8 { CPU, PPU };
+
+enum class DebugRegister : uint8 { A, X, Y, P, SP };
+
+// Break only when the masked register holds the value
+struct DebugCondition {
+  DebugRegister reg;
+  uint8 value;
+  uint8 mask {0xFF};
+};
+
+// Execution breakpoint or watchpoint on an inclusive range of addresses
+struct Breakpoint {
+  DebugSpace space {DebugSpace::CPU};
+  uint8 access {DEBUG_EXECUTE};
+  uint16 begin, end;
+  std::optional<DebugCondition> condition {};
+};
+
+// Execution breakpoints stop before the instruction, watchpoints once the instruction is over
+struct DebugHit {
+  uint32 id;
+  DebugSpace space;
+  DebugAccess access;
+  uint16 address, pc;
+  uint64 cycle;
+};
+
+// Thrown from the CPU to stop a run before an instruction, never leaves the run
+struct DebugBreak {};
+
+// Breakpoints and watchpoints of the console, summarized by flags of the 256 bytes pages they cover
+class Debugger {
+public:
+  uint32 add(const Breakpoint &breakpoint);
+  bool remove(uint32 id);
+  void clear();
+
+  // Look for a breakpoint matching the access, the first one matching is kept as the hit
+  bool check(DebugSpace space, uint16 n, DebugAccess access, const Cpu &cpu, uint64 cycle);
+
+  // Forget the hit, the execution breakpoint it stopped at is skipped once
+  void resume();
+
+  inline uint8 flags(DebugSpace space, uint16 n) const {
+    return space == DebugSpace::CPU ? m_cpu_pages[n >> 8] : m_ppu_pages[(n & 0x3FFF) >> 8];
+  }
+
+  // Some CPU pages have a read or write watchpoint
+  inline bool watching() const {
+    return m_watching;
+  }
+
+  inline const std::optional<DebugHit> &hit() const {
+    return m_hit;
+  }
+
+  inline const auto &breakpoints() const {
+    return m_breakpoints;
+  }
+
+private:
+  void map_pages();
+
+  std::vector<std::pair<uint32, Breakpoint>> m_breakpoints;
+  uint32 m_next_id {1};
+
+  std::array<uint8, 0x100> m_cpu_pages {};
+  std::array<uint8, 0x40> m_ppu_pages {};
+  bool m_watching {};
+
+  std::optional<DebugHit> m_hit;
+  std::optional<uint16> m_skip;
+};
+
+}  // namespace nemu
+
+#endif
@@ -0,0 +1,91 @@
+#include "frame_timings.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+#include <numeric>
+
+namespace nemu {
+
+FrameTimings::FrameTimings(size_t frames) : m_capacity {std::max<size_t>(frames, 1)} {
+  m_window.reserve(m_capacity), m_durations.reserve(m_capacity);
+}
+
+void FrameTimings::push(const FrameTime &time) {
+  if (m_window.size() < m_capacity) {
+    m_window.push_back(time);
+  } else {
+    m_window[m_frames % m_capacity] = time;
+  }
+
+  m_frames++;
+}
+
+TimeSummary FrameTimings::summary(Subsystem subsystem) const {
+  return summarize([subsystem](const FrameTime &time) { return time[subsystem]; });
+}
+
+TimeSummary FrameTimings::total() const {
+  return summarize([](const FrameTime &time) {
+    return std::accumulate(time.begin(), time.end(), std::chrono::nanoseconds {});
+  });
+}
+
+template<typename F>
+TimeSummary FrameTimings::summarize(F &&duration) const {
+  if (m_window.empty()) {
+    return {};
+  }
+
+  auto &durations = m_durations;
+  durations.resize(m_window.size());
+  std::ranges::transform(m_window, durations.begin(), duration);
+
+  auto at = [&](size_t percentile) {
+    auto nth = durations.begin() + (durations.size() - 1) * percentile / 100;
+    std::nth_element(durations.begin(), nth, durations.end());
+    return *nth;
+  };
+
+  auto sum = std::accumulate(durations.begin(), durations.end(), std::chrono::nanoseconds {});
+
+  return {
+    .p50 = at(50),
+    .p99 = at(99),
+    .max = std::ranges::max(durations),
+    .mean = sum / durations.size(),
+  };
+}
+
+void FrameTimings::write_json(std::ostream &output) const {
+  fmt::memory_buffer text;
+  auto out = std::back_inserter(text);
+
+  auto write_summary = [&](std::string_view name, const TimeSummary &summary, bool last) {
+    // Microseconds, the frame budget is around 16667
+    auto us = [](std::chrono::nanoseconds duration) { return duration.count() / 1e3; };
+
+    fmt::format_to(
+      out,
+      "    \"{}\": {{\"p50\": {:.3f}, \"p99\": {:.3f}, \"max\": {:.3f}, \"mean\": {:.3f}}}{}\n",
+      name,
+      us(summary.p50),
+      us(summary.p99),
+      us(summary.max),
+      us(summary.mean),
+      last ? "" : ","
+    );
+  };
+
+  fmt::format_to(out, "{{\n  \"frames\": {},\n  \"window\": {},\n  \"unit\": \"us\",\n", m_frames, m_window.size());
+  fmt::format_to(out, "  \"subsystems\": {{\n");
+
+  for (uint8 n = 0; n < SUBSYSTEM_COUNT; n++) {
+    write_summary(SUBSYSTEM_NAMES[n], summary(Subsystem(n)), false);
+  }
+
+  write_summary("frame", total(), true);
+  fmt::format_to(out, "  }}\n}}\n");
+
+  output.write(text.data(), text.size());
+}
+
+}  // namespace nemu
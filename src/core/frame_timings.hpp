@@ -0,0 +1,109 @@
+#ifndef NEMU_FRAME_TIMINGS_HPP
+#define NEMU_FRAME_TIMINGS_HPP
+
+#include "int.hpp"
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace nemu {
+
+// The console times its own subsystems, the frontend times the upload and the present of the frames
+enum Subsystem : uint8 {
+  SUBSYSTEM_CPU,
+  SUBSYSTEM_PPU,
+  SUBSYSTEM_BACKGROUND,
+  SUBSYSTEM_SPRITES,
+  SUBSYSTEM_UPLOAD,
+  SUBSYSTEM_PRESENT,
+  SUBSYSTEM_COUNT,
+};
+
+constexpr std::array<std::string_view, SUBSYSTEM_COUNT> SUBSYSTEM_NAMES = {
+  "cpu",
+  "ppu",
+  "background",
+  "sprites",
+  "upload",
+  "present",
+};
+
+// Time spent in every subsystem during a frame, the time of a subsystem excludes the ones nested in it
+using FrameTime = std::array<std::chrono::nanoseconds, SUBSYSTEM_COUNT>;
+
+// Add the time spent in the scope to a subsystem and take it off the enclosing one, nothing when null.
+// SUBSYSTEM_COUNT as the parent stands for no enclosing subsystem
+class ScopedTimer {
+public:
+  inline ScopedTimer(FrameTime *time, Subsystem subsystem, Subsystem parent = SUBSYSTEM_COUNT) :
+    m_time {time}, m_subsystem {subsystem}, m_parent {parent}, m_begin {} {
+    if (m_time) {
+      m_begin = std::chrono::steady_clock::now();
+    }
+  }
+
+  inline ~ScopedTimer() {
+    if (!m_time) {
+      return;
+    }
+
+    auto duration = std::chrono::steady_clock::now() - m_begin;
+    (*m_time)[m_subsystem] += duration;
+
+    if (m_parent != SUBSYSTEM_COUNT) {
+      (*m_time)[m_parent] -= duration;
+    }
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  FrameTime *m_time;
+  Subsystem m_subsystem;
+  Subsystem m_parent;
+  std::chrono::steady_clock::time_point m_begin;
+};
+
+// Percentiles of the time spent per frame
+struct TimeSummary {
+  std::chrono::nanoseconds p50, p99, max, mean;
+};
+
+// Times of the last frames, the window the percentiles are taken over
+class FrameTimings {
+public:
+  FrameTimings(size_t frames = 600);
+
+  // Keep the time of a frame, replacing the oldest one once the window is full
+  void push(const FrameTime &time);
+
+  TimeSummary summary(Subsystem subsystem) const;
+
+  // Summary of the time of the whole frames, every subsystem added up
+  TimeSummary total() const;
+
+  // Frames pushed since the start, including the ones out of the window
+  inline uint64 frames() const {
+    return m_frames;
+  }
+
+  void write_json(std::ostream &output) const;
+
+private:
+  template<typename F>
+  TimeSummary summarize(F &&duration) const;
+
+  std::vector<FrameTime> m_window;
+  size_t m_capacity;
+
+  // Durations sorted for the percentiles, allocated once so the frame loop doesn't allocate
+  mutable std::vector<std::chrono::nanoseconds> m_durations;
+  uint64 m_frames {};
+};
+
+}  // namespace nemu
+
+#endif
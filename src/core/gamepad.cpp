@@ -47,4 +47,12 @@ uint8 Gamepad::cpu_read(uint16 n) {
   return bit;
 }
 
+void Gamepad::save(StateWriter &state) const {
+  state.write(m_bits), state.write(m_strobe), state.write(m_mask);
+}
+
+void Gamepad::load(StateReader &state) {
+  state.read(m_bits), state.read(m_strobe), state.read(m_mask);
+}
+
 }  // namespace nemu
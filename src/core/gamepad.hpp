@@ -2,6 +2,7 @@
 #define NEMU_GAMEPAD_HPP
 
 #include "hardware.hpp"
+#include "state.hpp"
 #include <sdata.hpp>
 
 namespace nemu {
@@ -34,6 +35,9 @@ public:
   uint8 cpu_write(uint16 n, uint8 data);
   uint8 cpu_read(uint16 n);
 
+  void save(StateWriter &state) const;
+  void load(StateReader &state);
+
   inline auto zip() {
     return std::forward_as_tuple(m_bits, m_strobe, m_mask);
   }
@@ -2,7 +2,9 @@
 #define NEMU_MAPPER_HPP
 
 #include "int.hpp"
+#include "ppu/pattern.hpp"
 #include "rom.hpp"
+#include "state.hpp"
 #include <memory>
 #include <span>
 
@@ -18,6 +20,10 @@ public:
 
   virtual Mirror mirror() const = 0;
 
+  inline const Rom &rom() const {
+    return m_rom;
+  }
+
   virtual uint8 *cpu_write(uint16 n, uint8 data) = 0;
   virtual const uint8 *cpu_peek(uint16 n) const = 0;
   virtual uint8 *cpu_read(uint16 n) = 0;
@@ -28,8 +34,22 @@ public:
 
   virtual std::span<const uint8> pattern(uint8 n) const = 0;
 
+  inline const ppu::Tiles &tiles(uint8 n) const {
+    return m_patterns.tiles(n, pattern(n));
+  }
+
+  // Identify the PRG bank mapped at the CPU address, zero when not mapped to PRG memory
+  virtual uint32 prg_bank(uint16 n) const = 0;
+
+  // Registers and cartridge memory, the ROM itself isn't part of the state
+  virtual void save(StateWriter &) const {}
+  virtual void load(StateReader &) {}
+
 protected:
   Rom &m_rom;
+
+  // Written CHR bytes must be invalidated in the cache
+  mutable ppu::PatternCache m_patterns;
 };
 
 }  // namespace nemu
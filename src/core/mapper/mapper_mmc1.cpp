@@ -148,11 +148,10 @@ uint8 *MapperMmc1::ppu_write(uint16 n, uint8 data) {
     return nullptr;
   }
 
-  if (!m_rom.meta.chr_pages) {
-    return &(m_ram[map_chr(n)] = data);
-  } else {
-    return &(m_rom.character[map_chr(n)] = data);
-  }
+  uint8 *chr_write = m_rom.meta.chr_pages ? &m_rom.character[map_chr(n)] : &m_chr_ram[map_chr(n) & 0x1FFF];
+  m_patterns.invalidate(chr_write);
+
+  return &(*chr_write = data);
 }
 
 const uint8 *MapperMmc1::ppu_peek(uint16 n) const {
@@ -161,7 +160,7 @@ const uint8 *MapperMmc1::ppu_peek(uint16 n) const {
   }
 
   if (!m_rom.meta.chr_pages) {
-    return &(m_ram[map_chr(n)]);
+    return &(m_chr_ram[map_chr(n) & 0x1FFF]);
   } else {
     return &(m_rom.character[map_chr(n)]);
   }
@@ -173,7 +172,7 @@ uint8 *MapperMmc1::ppu_read(uint16 n) {
   }
 
   if (!m_rom.meta.chr_pages) {
-    return &(m_ram[map_chr(n)]);
+    return &(m_chr_ram[map_chr(n) & 0x1FFF]);
   } else {
     return &(m_rom.character[map_chr(n)]);
   }
@@ -183,4 +182,33 @@ std::span<const uint8> MapperMmc1::pattern(uint8 n) const {
   return {ppu_peek(n * 0x1000), 0x1000};
 }
 
+uint32 MapperMmc1::prg_bank(uint16 n) const {
+  switch (n) {
+  case 0x6000 ... 0x7FFF: return 1;
+  case 0x8000 ... 0xFFFF: return 2 + map_prg(n) / 0x2000;
+  }
+
+  return 0;
+}
+
+void MapperMmc1::save(StateWriter &state) const {
+  state.write(m_control), state.write(m_buffer), state.write(m_shift);
+  state.write(m_program_bank), state.write(m_character_bank);
+  state.write(m_ram);
+
+  if (!m_rom.meta.chr_pages) {
+    state.write(m_chr_ram);
+  }
+}
+
+void MapperMmc1::load(StateReader &state) {
+  state.read(m_control), state.read(m_buffer), state.read(m_shift);
+  state.read(m_program_bank), state.read(m_character_bank);
+  state.read(m_ram);
+
+  if (!m_rom.meta.chr_pages) {
+    state.read(m_chr_ram), m_patterns.invalidate();
+  }
+}
+
 }  // namespace nemu
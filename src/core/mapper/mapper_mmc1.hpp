@@ -26,12 +26,17 @@ public:
   uint8 *ppu_read(uint16 n) override;
 
   std::span<const uint8> pattern(uint8 n) const override;
+  uint32 prg_bank(uint16 n) const override;
+
+  void save(StateWriter &state) const override;
+  void load(StateReader &state) override;
 
 private:
   uint8 m_control, m_buffer, m_shift;
   uint8 m_program_bank[2], m_character_bank[2];
 
-  std::array<uint8, 0x2000> m_ram;
+  std::array<uint8, 0x2000> m_ram {};
+  std::array<uint8, 0x2000> m_chr_ram {};
 };
 
 }  // namespace nemu
@@ -3,6 +3,7 @@
 
 #include "mapper.hpp"
 #include "rom.hpp"
+#include <array>
 
 namespace nemu {
 
@@ -15,7 +16,7 @@ public:
   }
 
   uint16 map_chr(uint16 n) const {
-    return n & CHR_PAGE_SIZE;
+    return n & (CHR_PAGE_SIZE - 1);
   }
 
   Mirror mirror() const override {
@@ -35,20 +36,51 @@ public:
   }
 
   uint8 *ppu_write(uint16 n, uint8 data) override {
-    return n < 0x2000 ? &(m_rom.program[map_chr(n)] = data) : nullptr;
+    if (n > 0x1FFF) {
+      return nullptr;
+    }
+
+    uint8 *chr_write = &(character()[map_chr(n)] = data);
+    m_patterns.invalidate(chr_write);
+
+    return chr_write;
   }
 
   const uint8 *ppu_peek(uint16 n) const override {
-    return n < 0x2000 ? &(m_rom.program[map_chr(n)]) : nullptr;
+    return n < 0x2000 ? &(character()[map_chr(n)]) : nullptr;
   }
 
   uint8 *ppu_read(uint16 n) override {
-    return n < 0x2000 ? &(m_rom.program[map_chr(n)]) : nullptr;
+    return n < 0x2000 ? &(character()[map_chr(n)]) : nullptr;
   }
 
   std::span<const uint8> pattern(uint8 n) const override {
-    return {&m_rom.character[n * 0x1000], 0x1000};
+    return {&character()[n * 0x1000], 0x1000};
+  }
+
+  uint32 prg_bank(uint16 n) const override {
+    return n > 0x7FFF ? 1 + map_prg(n) / 0x2000 : 0;
+  }
+
+  void save(StateWriter &state) const override {
+    if (!m_rom.meta.chr_pages) {
+      state.write(m_chr_ram);
+    }
   }
+
+  void load(StateReader &state) override {
+    if (!m_rom.meta.chr_pages) {
+      state.read(m_chr_ram), m_patterns.invalidate();
+    }
+  }
+
+private:
+  // Cartridges without CHR-ROM pages come with CHR-RAM instead
+  inline std::span<uint8> character() const {
+    return m_rom.meta.chr_pages ? m_rom.character : std::span<uint8> {m_chr_ram};
+  }
+
+  mutable std::array<uint8, CHR_PAGE_SIZE> m_chr_ram {};
 };
 
 }  // namespace nemu
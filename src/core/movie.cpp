@@ -0,0 +1,115 @@
+#include "movie.hpp"
+#include "crc.hpp"
+#include "exception.hpp"
+#include <fstream>
+
+namespace nemu {
+
+// Header of a movie file, followed by the save-state it starts from and the frames
+struct MovieHeader {
+  constexpr static uint32 MAGIC = 0x564D454E;  // "NEMV"
+  constexpr static uint16 VERSION = 1;
+
+  uint32 magic;
+  uint16 version;
+  uint8 _[2];
+  uint32 state_size;
+  uint32 frames;
+};
+
+Movie Movie::power_on() {
+  return {};
+}
+
+Movie Movie::from_state(const Nes &nes) {
+  Movie movie;
+  movie.m_state.resize(nes.state_size());
+  nes.save(movie.m_state);
+
+  return movie;
+}
+
+Movie Movie::parse_file(std::string_view path) {
+  std::ifstream fstream {&path[0], std::ios::binary};
+
+  if (!fstream) {
+    throw Exception {"Can't open movie file from: '{}'", path};
+  }
+
+  MovieHeader header;
+  fstream.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+  if (!fstream || header.magic != MovieHeader::MAGIC || header.version != MovieHeader::VERSION) {
+    throw Exception {"Invalid movie file: '{}'", path};
+  }
+
+  Movie movie;
+  movie.m_state.resize(header.state_size), movie.m_frames.resize(header.frames);
+
+  fstream.read(reinterpret_cast<char *>(movie.m_state.data()), movie.m_state.size());
+  fstream.read(reinterpret_cast<char *>(movie.m_frames.data()), movie.m_frames.size() * sizeof(MovieFrame));
+
+  if (!fstream) {
+    throw Exception {"Truncated movie file: '{}'", path};
+  }
+
+  return movie;
+}
+
+void Movie::write_file(std::string_view path) const {
+  std::ofstream fstream {&path[0], std::ios::binary};
+
+  if (!fstream) {
+    throw Exception {"Can't write movie file to: '{}'", path};
+  }
+
+  MovieHeader header {
+    .magic = MovieHeader::MAGIC,
+    .version = MovieHeader::VERSION,
+    ._ = {},
+    .state_size = uint32(m_state.size()),
+    .frames = uint32(m_frames.size()),
+  };
+
+  fstream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  fstream.write(reinterpret_cast<const char *>(m_state.data()), m_state.size());
+  fstream.write(reinterpret_cast<const char *>(m_frames.data()), m_frames.size() * sizeof(MovieFrame));
+}
+
+void Movie::record(const Nes &nes) {
+  MovieFrame frame = checksums(nes);
+  frame.gamepads[0] = nes.gamepads()[0].bits(), frame.gamepads[1] = nes.gamepads()[1].bits();
+
+  m_frames.push_back(frame);
+}
+
+void Movie::start(Nes &nes) const {
+  if (!m_state.empty()) {
+    nes.load(m_state);
+  }
+}
+
+void Movie::apply(Nes &nes, uint64 frame) const {
+  for (uint8 n = 0; n < 2; n++) {
+    nes.gamepads()[n].release_button(GamepadButton(0xFF));
+    nes.gamepads()[n].press_button(GamepadButton(m_frames[frame].gamepads[n]));
+  }
+}
+
+bool Movie::check(const Nes &nes, uint64 frame) const {
+  MovieFrame checked = checksums(nes);
+  return checked.ram_crc == m_frames[frame].ram_crc && checked.canvas_crc == m_frames[frame].canvas_crc;
+}
+
+MovieFrame Movie::checksums(const Nes &nes) {
+  MovieFrame frame {};
+  frame.ram_crc = crc32(nes.ram());
+
+  for (uint16 y = 0; y < Canvas::H; y++) {
+    frame.canvas_crc = crc32(nes.ppu().canvas().row(y), frame.canvas_crc);
+  }
+
+  return frame;
+}
+
+}  // namespace nemu
@@ -0,0 +1,52 @@
+#ifndef NEMU_MOVIE_HPP
+#define NEMU_MOVIE_HPP
+
+#include "nes.hpp"
+#include <string_view>
+#include <vector>
+
+namespace nemu {
+
+// Gamepads state during a frame, with the checksums of the console once the frame has run
+struct MovieFrame {
+  uint8 gamepads[2];
+  uint8 _[2];
+  uint32 ram_crc, canvas_crc;
+};
+
+// Input log of both gamepads, replayed from power-on or from a save-state
+class Movie {
+public:
+  // Record from power-on, or from the current state of the console
+  static Movie power_on();
+  static Movie from_state(const Nes &nes);
+
+  static Movie parse_file(std::string_view path);
+  void write_file(std::string_view path) const;
+
+  // Called once a frame has run, with the gamepads still holding the input of the frame
+  void record(const Nes &nes);
+
+  // Bring the initialized console to the start of the movie
+  void start(Nes &nes) const;
+
+  // Feed the input of the frame to the gamepads before the frame runs
+  void apply(Nes &nes, uint64 frame) const;
+
+  // Compare the console with the checksums recorded once the frame has run, false on a desync
+  bool check(const Nes &nes, uint64 frame) const;
+
+  inline uint64 frames() const {
+    return m_frames.size();
+  }
+
+private:
+  static MovieFrame checksums(const Nes &nes);
+
+  std::vector<std::byte> m_state;
+  std::vector<MovieFrame> m_frames;
+};
+
+}  // namespace nemu
+
+#endif
@@ -1,13 +1,29 @@
 #include "nes.hpp"
+#include "crc.hpp"
 #include "exception.hpp"
 #include "mapper/mapper.hpp"
+#include <algorithm>
+#include <cstdint>
 
 namespace nemu {
 
-Nes::Nes(Rom &rom) : m_ppu {this}, m_gamepads {{this}, {this}}, m_mapper {Mapper::create(rom)} {}
+namespace {
+
+// Out of the hot paths, the message is only formatted when an access actually fails
+[[noreturn, gnu::cold]] void ppu_out_of_bounds(const char *access, uint16 n) {
+  throw Exception {"Out of bounds PPU {}: 0x{:04X}", access, n};
+}
+
+}  // namespace
+
+Nes::Nes(Rom &rom) : m_ppu {this}, m_gamepads {{this}, {this}}, m_mapper {Mapper::create(rom)},
+  m_rom_crc {crc32(rom.character, crc32(rom.program))} {}
 
 void Nes::init() {
+  m_cycles = 0, m_ppu_cycles = 0;
+
   m_mapper->init();
+  map_pages();
   m_cpu.init();
   m_ppu.init();
   m_gamepads[0].init();
@@ -15,32 +31,287 @@ void Nes::init() {
 }
 
 void Nes::tick() {
-  m_ppu.tick();
-  m_ppu.tick();
-  m_ppu.tick();
+  run(1);
+}
 
-  if (m_dma) {
-    if (m_dma->w ^= 1) {
-      m_dma->buffer = cpu_read(m_dma->page << 8 | m_dma->address);
-    } else {
-      m_ppu.dma_write(m_dma->address, m_dma->buffer);
+void Nes::run(uint64 cycles) {
+  uint64 target = m_cycles + cycles;
+
+  // A console stopped at a breakpoint doesn't run until resumed
+  if (m_debugger.hit()) {
+    return;
+  }
+
+  // The time of the PPU catching up is taken off, what is left is spent in the CPU
+  ScopedTimer timer {m_timings, SUBSYSTEM_CPU};
+
+  try {
+    while (m_cycles < target) {
+      if (m_dma) {
+        dma_tick();
+        continue;
+      }
+
+      uint64 execute = m_cycles + m_cpu.cycles_remaining();
+
+      // An NMI raised up to the cycle of the next instruction delays it for the interrupt
+      if (uint64 nmi = nmi_cycle(); nmi <= std::min(execute, target - 1)) {
+        catch_up(nmi + 1);
+        continue;
+      }
+
+      if (execute >= target) {
+        m_cpu.idle(target - m_cycles), m_cycles = target;
+        break;
+      }
+
+      m_cpu.idle(execute - m_cycles), m_cycles = execute;
+      m_cpu.tick(), m_cycles++;
+    }
+  } catch (const DebugBreak &) {
+    // Stopped before an instruction, on the cycle it was about to run at
+  }
+
+  catch_up(m_cycles);
+}
+
+RunResult Nes::run_until(uint64 cycle) {
+  uint64 cycles = m_cycles;
+  uint32 instructions = m_cpu.instruction_counter();
+
+  run(cycle > m_cycles ? cycle - m_cycles : 0);
+
+  return {m_cycles - cycles, m_cpu.instruction_counter() - instructions};
+}
+
+RunResult Nes::run_frame() {
+  uint64 cycles = m_cycles;
+  uint32 instructions = m_cpu.instruction_counter();
+  int32 framecount = m_ppu.framecount();
+
+  // Stop on the CPU cycle the frame ends in, the CPU may still change the odd frame skip on the way
+  while (m_ppu.framecount() == framecount && !m_debugger.hit()) {
+    run_until(m_ppu_cycles + (m_ppu.ticks_until_frame_end() + 2) / 3);
+  }
+
+  return {m_cycles - cycles, m_cpu.instruction_counter() - instructions};
+}
+
+void Nes::catch_up(uint64 cycles) {
+  if (m_ppu_cycles < cycles) {
+    ScopedTimer timer {m_timings, SUBSYSTEM_PPU, SUBSYSTEM_CPU};
+    m_ppu.run(3 * (cycles - m_ppu_cycles));
+    m_ppu_cycles = cycles;
+  }
+}
+
+void Nes::catch_up() {
+  // The PPU runs ahead of the CPU during a cycle
+  catch_up(m_cycles + 1);
+}
+
+uint32 Nes::add_breakpoint(const Breakpoint &breakpoint) {
+  uint32 id = m_debugger.add(breakpoint);
+  map_breakpoints();
+
+  return id;
+}
+
+bool Nes::remove_breakpoint(uint32 id) {
+  bool removed = m_debugger.remove(id);
+  map_breakpoints();
+
+  return removed;
+}
 
-      if (m_dma->address != 0xFF) {
-        m_dma->address++;
-      } else {
-        m_dma = std::nullopt;
+void Nes::clear_breakpoints() {
+  m_debugger.clear();
+  map_breakpoints();
+}
+
+void Nes::resume() {
+  m_debugger.resume();
+  map_pages();
+}
+
+bool Nes::debug_break(uint16 pc) {
+  // A watchpoint hit stops the run before the instruction following the access
+  return m_debugger.hit() || m_debugger.check(DebugSpace::CPU, pc, DEBUG_EXECUTE, m_cpu, m_cycles);
+}
+
+void Nes::watch_hit(DebugSpace space, uint16 n, DebugAccess access) {
+  // Untag the PRG banks for the next instruction to be fetched on the uncached path, where the run stops
+  if (m_debugger.check(space, n, access, m_cpu, m_cycles)) {
+    map_pages();
+  }
+}
+
+void Nes::map_breakpoints() {
+  // Watchpoints removed give their pages back to the page table
+  map_ram(), map_pages();
+
+  // Instructions of the pages with an execution breakpoint can't stay cached
+  for (uint16 page = 0x00; page < 0x100; page++) {
+    if (m_debugger.flags(DebugSpace::CPU, page << 8) & DEBUG_EXECUTE) {
+      for (uint16 n = page << 8; n < (page + 1) << 8; n++) {
+        m_cpu.invalidate(n);
       }
     }
+  }
+}
+
+#ifdef NEMU_TRACE
+void Nes::trace(const cpu::Decoded &decoded) {
+  if (!m_trace) {
+    return;
+  }
+
+  // Running the PPU up to the current cycle is what the next PPU access would do anyway
+  catch_up(m_cycles);
+
+  const auto &regs = m_cpu.registers();
+
+  m_trace->push({
+    .cycle = m_cycles,
+    .pc = regs.pc,
+    .opcode = decoded.opcode,
+    .operands = {decoded.operands[0], decoded.operands[1]},
+    .size = decoded.size,
+    .a = regs.a,
+    .x = regs.x,
+    .y = regs.y,
+    .p = regs.status.bits,
+    .sp = regs.sp,
+    .scanline = int16(m_ppu.scanline()),
+    .dot = uint16(m_ppu.dot()),
+  });
+}
+#endif
+
+uint64 Nes::nmi_cycle() const {
+  if (!m_ppu.nmi_enabled()) {
+    return UINT64_MAX;
+  }
+
+  return m_ppu_cycles + (m_ppu.ticks_until_vblank() - 1) / 3;
+}
+
+void Nes::dma_tick() {
+  catch_up();
+
+  if (m_dma->w ^= 1) {
+    m_dma->buffer = cpu_read(m_dma->page << 8 | m_dma->address);
   } else {
-    m_cpu.tick();
+    m_ppu.dma_write(m_dma->address, m_dma->buffer);
+
+    if (m_dma->address != 0xFF) {
+      m_dma->address++;
+    } else {
+      m_dma = std::nullopt;
+    }
+  }
+
+  m_cycles++;
+}
+
+size_t Nes::save(std::span<std::byte> buffer) const {
+  StateWriter state {buffer};
+  state.write(state_header());
+  write_state(state);
+
+  return state.size();
+}
+
+void Nes::load(std::span<const std::byte> buffer) {
+  StateReader state {buffer};
+  StateHeader header, expected = state_header();
+  state.read(header);
+
+  // Check everything before the console is touched, a rejected save-state leaves it as is
+  if (header.magic != expected.magic || header.version != expected.version) {
+    throw Exception {"Unsupported save-state version: {}", header.version};
+  }
+
+  if (header.mapper != expected.mapper || header.size != expected.size || buffer.size() < header.size) {
+    throw Exception {"Save-state of another cartridge: mapper {}, {} bytes", header.mapper, header.size};
   }
 
-  m_gamepads[0].tick();
-  m_gamepads[1].tick();
+  if (header.rom_crc != expected.rom_crc) {
+    throw Exception {"Save-state of another cartridge: ROM CRC {:08X}", header.rom_crc};
+  }
+
+  read_state(state);
+}
+
+size_t Nes::state_size() const {
+  return state_header().size;
+}
+
+StateHeader Nes::state_header() const {
+  const RomMeta &meta = m_mapper->rom().meta;
+
+  // Only count the bytes of the components
+  StateWriter state;
+  write_state(state);
+
+  return {
+    .magic = StateHeader::MAGIC,
+    .version = StateHeader::VERSION,
+    .mapper = uint8(meta.mapper_upper << 4 | meta.mapper_lower),
+    ._ = 0,
+    .size = uint32(sizeof(StateHeader) + state.size()),
+    .rom_crc = m_rom_crc,
+  };
+}
+
+void Nes::write_state(StateWriter &state) const {
+  m_cpu.save(state);
+  state.write(m_ram);
+  m_ppu.save(state);
+  m_gamepads[0].save(state), m_gamepads[1].save(state);
+  state.write(m_dma.has_value()), state.write(m_dma.value_or(ppu::Dma {}));
+  state.write(m_cycles), state.write(m_ppu_cycles);
+  m_mapper->save(state);
+}
+
+void Nes::read_state(StateReader &state) {
+  bool dma;
+  ppu::Dma dma_state;
+
+  m_cpu.load(state);
+  state.read(m_ram);
+  m_ppu.load(state);
+  m_gamepads[0].load(state), m_gamepads[1].load(state);
+  state.read(dma), state.read(dma_state);
+  state.read(m_cycles), state.read(m_ppu_cycles);
+  m_mapper->load(state);
+
+  m_dma = dma ? std::optional {dma_state} : std::nullopt;
+
+  // The banks may have been switched, and the instructions decoded from PRG-RAM are stale
+  map_pages();
+
+  if (m_mapper->prg_bank(0x6000)) {
+    m_cpu.invalidate(0x6000, 0x7FFF);
+  }
 }
 
 uint8 Nes::cpu_write(uint16 n, uint8 data) {
+  watch(DebugSpace::CPU, n, DEBUG_WRITE);
+
+  // Besides the RAM, writes may be observed by the PPU
+  if (n > 0x1FFF) {
+    catch_up();
+  }
+
   if (uint8 *mapper_write = m_mapper->cpu_write(n, data)) {
+    m_cpu.invalidate(n);
+
+    // Writes into the cartridge registers may switch the PRG banks
+    if (n > 0x7FFF) {
+      map_pages();
+    }
+
     return *mapper_write;
   }
 
@@ -107,6 +378,8 @@ uint8 Nes::cpu_peek(uint16 n) const {
 }
 
 uint8 Nes::cpu_read(uint16 n) {
+  watch(DebugSpace::CPU, n, DEBUG_READ);
+
   if (uint8 *mapper_read = m_mapper->cpu_read(n)) {
     return *mapper_read;
   }
@@ -117,6 +390,7 @@ uint8 Nes::cpu_read(uint16 n) {
   }
 
   case 0x2000 ... 0x3FFF: {
+    catch_up();
     return m_ppu.cpu_read(n);
   }
 
@@ -138,11 +412,38 @@ uint8 Nes::cpu_read(uint16 n) {
   return {};
 }
 
+void Nes::map_pages() {
+  // Nothing is cached while stopped at a breakpoint, see Nes::watch_hit
+  for (uint8 n = 0; n < m_prg_banks.size(); n++) {
+    m_prg_banks[n] = m_debugger.hit() ? 0 : m_mapper->prg_bank(n << 13);
+  }
+
+  // PRG-RAM and PRG-ROM pages are read directly, writes still reach the mapper
+  for (uint16 page = 0x60; page < 0x100; page++) {
+    m_read_pages[page] = m_mapper->cpu_read(page << 8);
+  }
+
+  // Watched pages go through the handlers, where the watchpoints are checked
+  if (m_debugger.watching()) {
+    for (uint16 page = 0x00; page < 0x100; page++) {
+      uint8 flags = m_debugger.flags(DebugSpace::CPU, page << 8);
+
+      if (flags & DEBUG_READ) {
+        m_read_pages[page] = nullptr;
+      }
+
+      if (flags & DEBUG_WRITE) {
+        m_write_pages[page] = nullptr;
+      }
+    }
+  }
+}
+
 uint8 Nes::ppu_write(uint16 n, uint8 data) {
   uint8 *mapper_write = m_mapper->ppu_write(n, data);
 
   if (!mapper_write) {
-    throw Exception {"Out of bounds PPU write: 0x{:04X}", n};
+    ppu_out_of_bounds("write", n);
   }
 
   return *mapper_write;
@@ -162,7 +463,7 @@ uint8 Nes::ppu_read(uint16 n) {
   uint8 *mapper_read = m_mapper->ppu_read(n);
 
   if (!mapper_read) {
-    throw Exception {"Out of bounds PPU read: 0x{:04X}", n};
+    ppu_out_of_bounds("read", n);
   }
 
   return *mapper_read;
@@ -2,13 +2,22 @@
 #define NEMU_NES_HPP
 
 #include "bus.hpp"
+#include "frame_timings.hpp"
 #include "gamepad.hpp"
 #include "ppu/dma.hpp"
 #include "ppu/ppu.hpp"
 #include "rom.hpp"
+#include "state.hpp"
+#include "trace_buffer.hpp"
 
 namespace nemu {
 
+// Work done by a run of the console
+struct RunResult {
+  uint64 cycles;
+  uint32 instructions;
+};
+
 class Nes : public Bus {
 public:
   Nes(Rom &rom);
@@ -16,10 +25,57 @@ public:
   void init() override;
   void tick() override;
 
+  // Run for a count of CPU cycles, catching the PPU up to the CPU only when needed
+  void run(uint64 cycles);
+
+  // Run up to the CPU cycle, or until the PPU has finished the current frame
+  RunResult run_until(uint64 cycle);
+  RunResult run_frame();
+
+  // Snapshot the whole console into the buffer, returns the count of bytes written
+  size_t save(std::span<std::byte> buffer) const;
+  void load(std::span<const std::byte> buffer);
+
+  // Count of bytes a save-state of this cartridge takes
+  size_t state_size() const;
+
+  // Breakpoints stop the runs until resumed, the page tables and the decoded instructions are updated
+  uint32 add_breakpoint(const Breakpoint &breakpoint);
+  bool remove_breakpoint(uint32 id);
+  void clear_breakpoints();
+  void resume();
+
+  bool debug_break(uint16 pc) override;
+
+  // Check the watchpoints of an access, only called from the slow paths of both buses
+  inline void watch(DebugSpace space, uint16 n, DebugAccess access) {
+    if (m_debugger.flags(space, n) & access) [[unlikely]] {
+      watch_hit(space, n, access);
+    }
+  }
+
   uint8 cpu_write(uint16 n, uint8 data) override;
   uint8 cpu_peek(uint16 n) const override;
   uint8 cpu_read(uint16 n) override;
 
+#ifdef NEMU_TRACE
+  // Push a record of every instruction executed into the buffer, null to stop tracing
+  inline void set_trace(TraceBuffer *trace) {
+    m_trace = trace;
+  }
+
+  void trace(const cpu::Decoded &decoded) override;
+#endif
+
+  // Add the time spent running the CPU and the PPU to the frame time, null to stop timing
+  inline void set_timings(FrameTime *timings) {
+    m_timings = timings;
+  }
+
+  inline FrameTime *timings() const {
+    return m_timings;
+  }
+
   uint8 ppu_write(uint16 n, uint8 data);
   uint8 ppu_peek(uint16 n) const;
   uint8 ppu_read(uint16 n);
@@ -28,10 +84,22 @@ public:
     return m_gamepads;
   }
 
+  inline const auto &gamepads() const {
+    return m_gamepads;
+  }
+
   inline Ppu &ppu() {
     return m_ppu;
   }
 
+  inline const Ppu &ppu() const {
+    return m_ppu;
+  }
+
+  inline uint64 cycles() const {
+    return m_cycles;
+  }
+
   inline auto mapper() const {
     return m_mapper;
   }
@@ -41,10 +109,36 @@ public:
   }
 
 private:
+  // Refresh the PRG bank tags and the page table after a bank switch
+  void map_pages();
+
+  void map_breakpoints();
+  void watch_hit(DebugSpace space, uint16 n, DebugAccess access);
+
+  void catch_up(uint64 cycles);
+  void catch_up();
+  uint64 nmi_cycle() const;
+
+  void dma_tick();
+
+  StateHeader state_header() const;
+  void write_state(StateWriter &state) const;
+  void read_state(StateReader &state);
+
   Ppu m_ppu;
   Gamepad m_gamepads[2];
   std::shared_ptr<class Mapper> m_mapper;
+  uint32 m_rom_crc;
   std::optional<ppu::Dma> m_dma;
+
+  // Master clock in CPU cycles, and the cycle count the PPU has been run up to
+  uint64 m_cycles, m_ppu_cycles;
+
+  FrameTime *m_timings {};
+
+#ifdef NEMU_TRACE
+  TraceBuffer *m_trace {};
+#endif
 };
 
 }  // namespace nemu
@@ -0,0 +1,133 @@
+#include "perf_counters.hpp"
+#include <fmt/format.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace nemu {
+
+PerfCounts &PerfCounts::operator+=(const PerfCounts &counts) {
+  for (uint8 n = 0; n < PERF_EVENT_COUNT; n++) {
+    if (counts.events[n]) {
+      events[n] = events[n].value_or(0) + *counts.events[n];
+    }
+  }
+
+  return *this;
+}
+
+std::optional<f64> PerfCounts::ipc() const {
+  if (!events[PERF_CYCLES] || !events[PERF_INSTRUCTIONS] || !*events[PERF_CYCLES]) {
+    return std::nullopt;
+  }
+
+  return f64(*events[PERF_INSTRUCTIONS]) / *events[PERF_CYCLES];
+}
+
+#ifdef __linux__
+
+// Type and config of every event, the caches are read misses
+constexpr std::array<std::pair<uint32, uint64>, PERF_EVENT_COUNT> PERF_EVENT_CONFIGS = {{
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {
+    PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+  },
+  {
+    PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+  },
+}};
+
+PerfCounters::PerfCounters() {
+  for (uint8 n = 0; n < PERF_EVENT_COUNT; n++) {
+    perf_event_attr attr {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_EVENT_CONFIGS[n].first;
+    attr.config = PERF_EVENT_CONFIGS[n].second;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // The counters are multiplexed when the PMU runs out of them, the counts are scaled back
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    m_fds[n] = int32(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+    if (m_fds[n] < 0 && m_error.empty()) {
+      m_error = fmt::format("{}: {}", PERF_EVENT_NAMES[n], std::strerror(errno));
+    }
+
+    m_available |= m_fds[n] >= 0;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int32 fd : m_fds) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+void PerfCounters::start() {
+  for (int32 fd : m_fds) {
+    if (fd >= 0) {
+      ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+PerfCounts PerfCounters::stop() {
+  PerfCounts counts {};
+
+  for (int32 fd : m_fds) {
+    if (fd >= 0) {
+      ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  for (uint8 n = 0; n < PERF_EVENT_COUNT; n++) {
+    uint64 values[3];
+
+    if (m_fds[n] < 0 || ::read(m_fds[n], values, sizeof(values)) != sizeof(values)) {
+      continue;
+    }
+
+    auto [value, enabled, running] = values;
+
+    // A counter that never got on the PMU is as good as unavailable
+    if (running) {
+      counts.events[n] = running < enabled ? uint64(f64(value) * enabled / running) : value;
+    }
+  }
+
+  return counts;
+}
+
+#else
+
+PerfCounters::PerfCounters() : m_error {"perf_event_open is only available on Linux"} {
+  m_fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters() {}
+
+void PerfCounters::start() {}
+
+PerfCounts PerfCounters::stop() {
+  return {};
+}
+
+#endif
+
+}  // namespace nemu
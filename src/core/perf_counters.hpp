@@ -0,0 +1,70 @@
+#ifndef NEMU_PERF_COUNTERS_HPP
+#define NEMU_PERF_COUNTERS_HPP
+
+#include "int.hpp"
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace nemu {
+
+enum PerfEvent : uint8 {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_EVENT_COUNT,
+};
+
+constexpr std::array<std::string_view, PERF_EVENT_COUNT> PERF_EVENT_NAMES = {
+  "cycles",
+  "instructions",
+  "branch_misses",
+  "l1d_misses",
+  "llc_misses",
+};
+
+// Counts of the host events over the regions measured, empty for the counters that couldn't be opened
+struct PerfCounts {
+  std::array<std::optional<uint64>, PERF_EVENT_COUNT> events;
+
+  PerfCounts &operator+=(const PerfCounts &counts);
+
+  // Instructions per cycle of the host, when both are counted
+  std::optional<f64> ipc() const;
+};
+
+// Hardware counters of the calling thread from perf_event_open, user space only. Every counter is
+// opened on its own, those refused by the kernel, the PMU or a container are left out
+class PerfCounters {
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  // Count from zero until stopped, nothing is counted in between
+  void start();
+  PerfCounts stop();
+
+  inline bool available() const {
+    return m_available;
+  }
+
+  // Why the first counter refused couldn't be opened, empty when all were
+  inline const std::string &error() const {
+    return m_error;
+  }
+
+private:
+  std::array<int32, PERF_EVENT_COUNT> m_fds;
+  bool m_available {};
+  std::string m_error;
+};
+
+}  // namespace nemu
+
+#endif
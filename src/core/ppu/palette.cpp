@@ -0,0 +1,38 @@
+#include "palette.hpp"
+#include "ppu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace nemu::ppu {
+
+void convert_row(uint32 *texels, const uint8 *row) {
+  for (uint16 x = 0; x < Canvas::W; x++) {
+    texels[x] = TEXELS[row[x]];
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2"))) void convert_row_avx2(uint32 *texels, const uint8 *row) {
+  for (uint16 x = 0; x < Canvas::W; x += 8) {
+    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(&row[x])));
+    __m256i texel = _mm256_i32gather_epi32(reinterpret_cast<const int32 *>(TEXELS.data()), index, 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&texels[x]), texel);
+  }
+}
+
+#endif
+
+ConvertRow select_convert_row() {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    return convert_row_avx2;
+  }
+#endif
+
+  return convert_row;
+}
+
+}  // namespace nemu::ppu
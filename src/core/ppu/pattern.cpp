@@ -0,0 +1,64 @@
+#include "pattern.hpp"
+#include <algorithm>
+
+namespace nemu::ppu {
+
+const Tiles &PatternCache::tiles(uint8 table, std::span<const uint8> pattern) {
+  const Page *page = m_last[table];
+
+  if (page && page->data == pattern.data() && page->valid) [[likely]] {
+    return page->tiles;
+  }
+
+  return find(table, pattern);
+}
+
+const Tiles &PatternCache::find(uint8 table, std::span<const uint8> pattern) {
+  auto page = std::ranges::find(m_pages, pattern.data(), [](const auto &page) {
+    return page->data;
+  });
+
+  if (page == m_pages.end()) {
+    page = m_pages.insert(page, std::make_unique<Page>(pattern.data(), false));
+  }
+
+  if (!(*page)->valid) {
+    for (uint16 n = 0; n < (*page)->tiles.size(); n++) {
+      Tile &tile = (*page)->tiles[n];
+
+      for (uint8 y = 0; y < 8; y++) {
+        uint8 pattern_a = pattern[n * 16 + 0 + y];
+        uint8 pattern_b = pattern[n * 16 + 8 + y];
+
+        for (uint8 x = 0; x < 8; x++) {
+          uint8 a = (pattern_a >> (7 - x)) & 0b1;
+          uint8 b = (pattern_b >> (7 - x)) & 0b1;
+
+          tile.pixels[0][y][x] = tile.pixels[1][y][7 - x] = a | b << 1;
+        }
+      }
+    }
+
+    (*page)->valid = true;
+  }
+
+  m_last[table] = page->get();
+
+  return (*page)->tiles;
+}
+
+void PatternCache::invalidate(const uint8 *n) {
+  for (auto &page : m_pages) {
+    if (n >= page->data && n < page->data + 0x1000) {
+      page->valid = false;
+    }
+  }
+}
+
+void PatternCache::invalidate() {
+  for (auto &page : m_pages) {
+    page->valid = false;
+  }
+}
+
+}  // namespace nemu::ppu
@@ -0,0 +1,47 @@
+#ifndef NEMU_PATTERN_HPP
+#define NEMU_PATTERN_HPP
+
+#include "int.hpp"
+#include <array>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace nemu::ppu {
+
+// Pattern tile decoded into 2 bits pixel indices, as stored and flipped horizontally
+struct Tile {
+  std::array<std::array<uint8, 8>, 8> pixels[2];
+};
+
+using Tiles = std::array<Tile, 256>;
+
+// Decoded tiles keyed by the CHR page they were decoded from, bank switches select another page
+class PatternCache {
+public:
+  // The page last used by each pattern table is checked first, the banks rarely switch within a frame
+  const Tiles &tiles(uint8 table, std::span<const uint8> pattern);
+
+  // Drop the decoded page holding the written CHR byte
+  void invalidate(const uint8 *n);
+
+  // Drop every decoded page, keeping them allocated
+  void invalidate();
+
+private:
+  struct Page {
+    const uint8 *data;
+    bool valid;
+    Tiles tiles;
+  };
+
+  // Look the page up, decode it when invalid, and keep it as the last page of the table
+  const Tiles &find(uint8 table, std::span<const uint8> pattern);
+
+  std::vector<std::unique_ptr<Page>> m_pages;
+  std::array<const Page *, 2> m_last {};
+};
+
+}  // namespace nemu::ppu
+
+#endif
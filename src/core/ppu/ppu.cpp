@@ -5,7 +5,9 @@
 #include "mapper/mapper_mmc1.hpp"
 #include "misc.hpp"
 #include "nes.hpp"
+#include "pattern.hpp"
 #include "sprite.hpp"
+#include <algorithm>
 #include <tuple>
 
 namespace nemu {
@@ -15,7 +17,7 @@ using namespace ppu;
 Ppu::Ppu(Nes *nes) : Hardware {nes} {}
 
 void Ppu::init() {
-  m_vram = {}, m_colors = {};
+  m_oam = {}, m_vram = {}, m_colors = {};
   m_scanline = 0, m_ticks = 0, m_framecount = 0;
 
   m_regs = {
@@ -28,7 +30,27 @@ void Ppu::init() {
   };
 }
 
+void Ppu::save(StateWriter &state) const {
+  state.write(m_regs);
+  state.write(m_oam), state.write(m_vram), state.write(m_colors);
+  state.write(m_scanline), state.write(m_ticks), state.write(m_framecount);
+}
+
+void Ppu::load(StateReader &state) {
+  state.read(m_regs);
+  state.read(m_oam), state.read(m_vram), state.read(m_colors);
+  state.read(m_scanline), state.read(m_ticks), state.read(m_framecount);
+}
+
 void Ppu::tick() {
+  // Scanlines are rendered from the registers at the end of the previous hblank
+  ppu_event("render_scanline", 0, std::nullopt, [this] {
+    if (m_rendering && m_scanline >= 0 && m_scanline < Canvas::H) {
+      ScopedTimer timer {m_bus.timings(), SUBSYSTEM_BACKGROUND, SUBSYSTEM_PPU};
+      render_background(m_canvas, m_scanline);
+    }
+  });
+
   ppu_event("render_first_tick", 0, 0, [this] {
     if ((m_regs.mask.bgr_show) && (m_framecount & 0b1)) {
       m_ticks = 1;  // Skipped on Odd + Background
@@ -36,8 +58,10 @@ void Ppu::tick() {
   });
 
   ppu_event("render_finished", 0, 240, [this] {
-    render_background(m_canvas);
-    render_sprites(m_canvas);
+    if (m_rendering) {
+      ScopedTimer timer {m_bus.timings(), SUBSYSTEM_SPRITES, SUBSYSTEM_PPU};
+      render_sprites(m_canvas);
+    }
   });
 
   ppu_event("set_vblank", 1, 241, [this] {
@@ -71,6 +95,56 @@ void Ppu::tick() {
   });
 }
 
+void Ppu::run(uint32 ticks) {
+  while (ticks > 0) {
+    // No event happens between the second and the last tick of a scanline
+    if (m_ticks > 1 && m_ticks < 340) {
+      uint32 skip = std::min<uint32>(ticks, 340 - m_ticks);
+      m_ticks += skip, ticks -= skip;
+    } else {
+      tick(), ticks--;
+    }
+  }
+}
+
+uint32 Ppu::ticks_until_vblank() const {
+  constexpr int32 W = 341;
+
+  // Linear tick positions in the frame, the pre-render scanline is negative
+  constexpr int32 VBLANK = 241 * W + 1;
+  constexpr int32 LAST = 260 * W + 340;
+
+  int32 position = m_scanline * W + m_ticks;
+
+  // The first tick of an odd frame is skipped when rendering the background
+  auto skipped = [this](int32 framecount) -> uint32 {
+    return m_regs.mask.bgr_show && (framecount & 0b1);
+  };
+
+  if (position <= 0) {
+    return VBLANK - position + 1 - skipped(m_framecount);
+  }
+
+  if (position <= VBLANK) {
+    return VBLANK - position + 1;
+  }
+
+  // Wrap around the pre-render scanline (ticks 1 to 340) into the next frame
+  return (LAST - position + 1) + 340 + (VBLANK + 1) - skipped(m_framecount + 1);
+}
+
+uint32 Ppu::ticks_until_frame_end() const {
+  constexpr int32 W = 341;
+  constexpr int32 LAST = 260 * W + 340;
+
+  int32 position = m_scanline * W + m_ticks;
+
+  // The first tick of an odd frame is skipped when rendering the background
+  uint32 skipped = position <= 0 && m_regs.mask.bgr_show && (m_framecount & 0b1);
+
+  return LAST - position + 1 - skipped;
+}
+
 uint8 Ppu::dma_write(uint8 n, uint8 data) {
   return m_oam[n] = data;
 }
@@ -188,6 +262,11 @@ uint8 Ppu::cpu_read(uint16 n) {
 
 uint8 Ppu::ppu_write(uint8 data) {
   uint16 n = ppu_address();
+  m_bus.watch(DebugSpace::PPU, n, DEBUG_WRITE);
+
+#ifdef NEMU_PROFILE
+  m_bus.profile_ppu(n, PROFILE_WRITE);
+#endif
 
   switch (n) {
   case 0x0000 ... 0x1FFF: {
@@ -227,6 +306,11 @@ uint8 Ppu::ppu_peek() const {
 uint8 Ppu::ppu_read() {
   uint8 output = m_regs.buffer;
   uint16 n = ppu_address();
+  m_bus.watch(DebugSpace::PPU, n, DEBUG_READ);
+
+#ifdef NEMU_PROFILE
+  m_bus.profile_ppu(n, PROFILE_READ);
+#endif
 
   // PPU Reads are done with one cycle delay excepted for the palette ram which we read from directly
   switch (n) {
@@ -313,48 +397,59 @@ uint16 Ppu::color_address(uint16 n) const {
   return mapped;
 }
 
-Canvas &Ppu::render_background(Canvas &canvas) const {
+Canvas &Ppu::render_background(Canvas &canvas, uint8 j) const {
   if (!m_regs.mask.bgr_show) {
     return canvas;
   }
 
   uint8 bank = m_regs.control.bgr_bank;
-  auto pattern = m_bus.mapper()->pattern(bank);
+  const Tiles &tiles = m_bus.mapper()->tiles(bank);
 
-  for (uint16 i = 0; i < Canvas::W; i++) {
-    for (uint16 j = 0; j < Canvas::H; j++) {
-      // Get the scroll wrapped around the two nametables
-      uint16 x = (m_regs.scroll.x + i + (m_regs.control.nt_x * Canvas::W)) % (Canvas::W * 2);
-      uint16 y = (m_regs.scroll.y + j + (m_regs.control.nt_y * Canvas::H)) % (Canvas::H * 2);
+  // Get the scroll wrapped around the two nametables
+  uint16 x = (m_regs.scroll.x + (m_regs.control.nt_x * Canvas::W)) % (Canvas::W * 2);
+  uint16 y = (m_regs.scroll.y + j + (m_regs.control.nt_y * Canvas::H)) % (Canvas::H * 2);
 
-      // Inner nametable tile coordinates
-      uint8 r = (x % Canvas::W) / 8;
-      uint8 c = (y % Canvas::H) / 8;
+  // Inner nametable tile row and the half of the attribute quadrant it falls in
+  uint8 c = (y % Canvas::H) / 8;
+  uint8 half_b = (uint8(c / 2) & 0b1) ? 0b1'0 : 0b0'0;
 
-      // Select from which nametable we are rendering depending on the current scroll
-      uint8 n = x >= Canvas::W || y >= Canvas::H;
+  auto row = canvas.row(j);
 
-      uint16 nt_index = r + c * (Canvas::W / 8);
-      uint16 nt_value = m_vram[(n * 0x400) + nt_index];
+  // The first tile is partially scrolled out on the left
+  for (int16 i = -(x % 8), tile = x - x % 8; i < Canvas::W; i += 8, tile = (tile + 8) % (Canvas::W * 2)) {
+    uint8 r = (tile % Canvas::W) / 8;
 
-      auto pattern_a = pattern.subspan(nt_value * 16 + 0, 8);
-      auto pattern_b = pattern.subspan(nt_value * 16 + 8, 8);
+    // Select from which nametable we are rendering depending on the current scroll
+    uint8 n = tile >= Canvas::W || y >= Canvas::H;
 
-      uint8 a = pattern_a[y % 8] & (1 << (7 - x % 8)) ? 0b0'1 : 0b0'0;
-      uint8 b = pattern_b[y % 8] & (1 << (7 - x % 8)) ? 0b1'0 : 0b0'0;
+    uint16 nt_index = r + c * (Canvas::W / 8);
+    uint16 nt_value = m_vram[(n * 0x400) + nt_index];
 
-      uint8 half_a = (uint8(r / 2) & 0b1) ? 0b0'1 : 0b0'0;
-      uint8 half_b = (uint8(c / 2) & 0b1) ? 0b1'0 : 0b0'0;
+    const auto &pixels = tiles[nt_value].pixels[0][y % 8];
 
-      uint8 quadrant = (half_a | half_b);
-      uint8 ab_index = (r / 4) + (c / 4) * (Canvas::W / 8 / 4);
-      uint8 ab_value = (m_vram[(n * 0x400 + 0x3C0) + ab_index] >> (2 * quadrant)) & 0b11;
+    uint8 half_a = (uint8(r / 2) & 0b1) ? 0b0'1 : 0b0'0;
 
-      if (a | b) {
-        canvas.buffer[i][j] = m_colors[(ab_value << 2) | (a | b)];
-      } else {
-        canvas.buffer[i][j] = m_colors[0x00];  // Draw background color
-      }
+    uint8 quadrant = (half_a | half_b);
+    uint8 ab_index = (r / 4) + (c / 4) * (Canvas::W / 8 / 4);
+    uint8 ab_value = (m_vram[(n * 0x400 + 0x3C0) + ab_index] >> (2 * quadrant)) & 0b11;
+
+    // Index 0 of every palette draws the background color
+    const uint8 *colors = &m_colors[ab_value << 2];
+
+#ifdef NEMU_PROFILE
+    // The fetches of a tile row, the pattern planes are counted once at the address of the first one
+    m_bus.profile_ppu(0x2000 + n * 0x400 + nt_index, PROFILE_READ);
+    m_bus.profile_ppu(0x2000 + n * 0x400 + 0x3C0 + ab_index, PROFILE_READ);
+    m_bus.profile_ppu(bank * 0x1000 + nt_value * 16 + y % 8, PROFILE_READ);
+    m_bus.profile_ppu(0x3F00 + (ab_value << 2), PROFILE_READ);
+#endif
+    uint8 palette[4] = {m_colors[0x00], colors[1], colors[2], colors[3]};
+
+    // Only the first and the last tiles are clipped by the screen
+    uint8 begin = std::max<int16>(0, -i), end = std::min<int16>(8, Canvas::W - i);
+
+    for (uint8 k = begin; k < end; k++) {
+      row[i + k] = palette[pixels[k]];
     }
   }
 
@@ -367,26 +462,29 @@ Canvas &Ppu::render_sprites(Canvas &canvas) const {
   }
 
   auto render_sprite = [&](Sprite sprite, uint8 bank) {
-    auto pattern = m_bus.mapper()->pattern(bank);
+    // The flipped variant of the tile is already stored in screen order
+    const auto &pixels = m_bus.mapper()->tiles(bank)[sprite.index].pixels[sprite.ab.flip & 0b0'1];
 
-    auto pattern_a = pattern.subspan(sprite.index * 16 + 0, 8);
-    auto pattern_b = pattern.subspan(sprite.index * 16 + 8, 8);
+#ifdef NEMU_PROFILE
+    m_bus.profile_ppu(bank * 0x1000 + sprite.index * 16, PROFILE_READ);
+#endif
 
     for (uint8 c = 0; c < 8; c++) {
       for (uint8 r = 0; r < 8; r++) {
-        uint16 x = sprite.position[0] + (sprite.ab.flip & 0b0'1 ? r : 7 - r);
+        uint8 column = sprite.ab.flip & 0b0'1 ? r : 7 - r;
+
+        uint16 x = sprite.position[0] + column;
         uint16 y = sprite.position[1] + (sprite.ab.flip & 0b1'0 ? 7 - c : c);
 
-        if (y < 2 || x > Canvas::W || y > Canvas::H) {
+        if (y < 2 || x >= Canvas::W || y >= Canvas::H) {
           return;  // Sprite is not on the screen anymore
         }
 
-        uint8 a = pattern_a[c] & (1 << r) ? 0b0'1 : 0b0'0;
-        uint8 b = pattern_b[c] & (1 << r) ? 0b1'0 : 0b0'0;
+        uint8 pixel = pixels[c][column];
 
         // The sprite either need to be opaque or have the priority to be displayed
-        if ((a | b) && (canvas.buffer[x][y] == m_colors[0x00] || sprite.ab.priority < 1)) {
-          canvas.buffer[x][y] = m_colors[0x10 + (sprite.ab.color << 2) | (a | b)];
+        if (pixel && (canvas.at(x, y) == m_colors[0x00] || sprite.ab.priority < 1)) {
+          canvas.at(x, y) = m_colors[0x10 + (sprite.ab.color << 2) | pixel];
         }
       }
     }
@@ -4,14 +4,34 @@
 #include "hardware.hpp"
 #include "misc.hpp"
 #include "registers.hpp"
+#include "state.hpp"
 #include <string_view>
 #include <array>
+#include <span>
 
 namespace nemu {
 
+// Row-major framebuffer, rows are padded to a multiple of the cache line size
 struct Canvas {
-  enum : uint16 { W = 256, H = 240 };
-  std::array<std::array<uint8, H>, W> buffer {};
+  enum : uint16 { W = 256, H = 240, PITCH = (W + 63) / 64 * 64 };
+
+  inline uint8 &at(uint16 x, uint16 y) {
+    return buffer[y * PITCH + x];
+  }
+
+  inline uint8 at(uint16 x, uint16 y) const {
+    return buffer[y * PITCH + x];
+  }
+
+  inline std::span<uint8, W> row(uint16 y) {
+    return std::span<uint8, W> {&buffer[y * PITCH], W};
+  }
+
+  inline std::span<const uint8, W> row(uint16 y) const {
+    return std::span<const uint8, W> {&buffer[y * PITCH], W};
+  }
+
+  alignas(64) std::array<uint8, PITCH * H> buffer {};
 };
 
 class Ppu : public Hardware<class Nes> {
@@ -20,6 +40,23 @@ public:
   void init() override;
   void tick() override;
 
+  // Advance by a count of PPU ticks, skipping the ticks where no event happens
+  void run(uint32 ticks);
+
+  // Count of ticks to run until the vblank event has been processed
+  uint32 ticks_until_vblank() const;
+
+  // Count of ticks to run until the frame is finished and the frame count incremented
+  uint32 ticks_until_frame_end() const;
+
+  // Draw a scanline of the background or every sprite from the current PPU state
+  Canvas &render_background(Canvas &canvas, uint8 j) const;
+  Canvas &render_sprites(Canvas &canvas) const;
+
+  // The canvas is an output and isn't part of the state
+  void save(StateWriter &state) const;
+  void load(StateReader &state);
+
   uint8 dma_write(uint8 n, uint8 data);
   uint8 cpu_write(uint16 n, uint8 data);
   uint8 cpu_peek(uint16 n) const;
@@ -33,9 +70,30 @@ public:
     return m_canvas;
   };
 
+  inline const Canvas &canvas() const {
+    return m_canvas;
+  };
+
+  // Frames run without rendering leave the canvas as is, the rest of the emulation is the same
+  inline void set_rendering(bool rendering) {
+    m_rendering = rendering;
+  }
+
+  inline int32 scanline() const {
+    return m_scanline;
+  }
+
+  inline int32 dot() const {
+    return m_ticks;
+  }
+
   inline int32 framecount() const {
     return m_framecount;
   }
+
+  inline bool nmi_enabled() const {
+    return m_regs.control.nmi;
+  }
   
 private:
   template<typename F, typename R = std::invoke_result_t<F>>
@@ -64,8 +122,6 @@ private:
   uint16 color_address(uint16 n) const;
 
   Canvas &render_nametable(Canvas &canvas, uint8 n, int8 offset) const;
-  Canvas &render_background(Canvas &canvas) const;
-  Canvas &render_sprites(Canvas &canvas) const;
 
   ppu::Registers m_regs;
   Canvas m_canvas {};
@@ -75,6 +131,7 @@ private:
   std::array<uint8, 0x020> m_colors;
 
   int32 m_scanline, m_ticks, m_framecount;
+  bool m_rendering {true};
 };
 
 }  // namespace nemu
@@ -0,0 +1,127 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace nemu {
+
+constexpr std::string_view REGION_NAMES[] = {
+  "pattern0",
+  "pattern1",
+  "nametable0",
+  "nametable1",
+  "nametable2",
+  "nametable3",
+  "palette",
+};
+
+PpuRegion Profiler::region(uint16 n) {
+  n &= 0x3FFF;
+
+  if (n < 0x2000) {
+    return PpuRegion(uint8(PpuRegion::PATTERN_0) + n / 0x1000);
+  }
+
+  if (n < 0x3F00) {
+    return PpuRegion(uint8(PpuRegion::NAMETABLE_0) + (n & 0x0FFF) / 0x400);
+  }
+
+  return PpuRegion::PALETTE;
+}
+
+std::array<ProfileCounts, 7> Profiler::regions() const {
+  std::array<ProfileCounts, 7> output {};
+
+  for (uint32 n = 0; n < m_ppu.size(); n++) {
+    auto &counts = output[uint8(region(n))];
+
+    for (uint8 access = 0; access < counts.size(); access++) {
+      counts[access] += m_ppu[n][access];
+    }
+  }
+
+  return output;
+}
+
+std::vector<HotSpot> Profiler::hottest(size_t count) const {
+  std::vector<HotSpot> output;
+
+  // Code of PRG memory is counted by bank, the rest by address
+  for (uint32 n = 0; n < 0x6000; n++) {
+    if (m_cpu[n][PROFILE_EXECUTE]) {
+      output.push_back({0, uint16(n), m_cpu[n][PROFILE_EXECUTE]});
+    }
+  }
+
+  for (size_t n = 0; n < m_prg.size(); n++) {
+    if (m_prg[n][PROFILE_EXECUTE]) {
+      output.push_back({uint32(n / BANK_SIZE + 1), uint16(n % BANK_SIZE), m_prg[n][PROFILE_EXECUTE]});
+    }
+  }
+
+  count = std::min(count, output.size());
+  std::ranges::partial_sort(output, output.begin() + count, std::ranges::greater {}, &HotSpot::executes);
+  output.resize(count);
+
+  return output;
+}
+
+void Profiler::reset() {
+  m_cpu = {}, m_ppu = {};
+  std::ranges::fill(m_prg, ProfileCounts {});
+}
+
+void Profiler::write_csv_header(std::ostream &output) {
+  output << "frame,space,region,address,reads,writes,executes\n";
+}
+
+void Profiler::write_csv(std::ostream &output, int64 frame) const {
+  fmt::memory_buffer text;
+  std::string frame_column = frame < 0 ? "" : fmt::format("{}", frame);
+
+  auto write_row = [&](std::string_view space, auto region, uint32 address, const ProfileCounts &counts) {
+    if (counts[PROFILE_READ] || counts[PROFILE_WRITE] || counts[PROFILE_EXECUTE]) {
+      fmt::format_to(
+        std::back_inserter(text),
+        "{},{},{},{:04X},{},{},{}\n",
+        frame_column,
+        space,
+        region,
+        address,
+        counts[PROFILE_READ],
+        counts[PROFILE_WRITE],
+        counts[PROFILE_EXECUTE]
+      );
+    }
+  };
+
+  for (uint32 n = 0; n < m_cpu.size(); n++) {
+    write_row("cpu", "", n, m_cpu[n]);
+  }
+
+  // The PRG addresses are offsets in their bank
+  for (size_t n = 0; n < m_prg.size(); n++) {
+    write_row("prg", n / BANK_SIZE + 1, n % BANK_SIZE, m_prg[n]);
+  }
+
+  for (uint32 n = 0; n < m_ppu.size(); n++) {
+    write_row("ppu", REGION_NAMES[uint8(region(n))], n, m_ppu[n]);
+  }
+
+  output.write(text.data(), text.size());
+}
+
+void Profiler::write_binary(std::ostream &output, int64 frame) const {
+  ProfileHeader header {
+    .magic = ProfileHeader::MAGIC,
+    .version = ProfileHeader::VERSION,
+    .banks = uint16(m_prg.size() / BANK_SIZE),
+    .frame = frame,
+  };
+
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  output.write(reinterpret_cast<const char *>(m_cpu.data()), sizeof(m_cpu));
+  output.write(reinterpret_cast<const char *>(m_ppu.data()), sizeof(m_ppu));
+  output.write(reinterpret_cast<const char *>(m_prg.data()), m_prg.size() * sizeof(ProfileCounts));
+}
+
+}  // namespace nemu
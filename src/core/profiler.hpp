@@ -0,0 +1,114 @@
+#ifndef NEMU_PROFILER_HPP
+#define NEMU_PROFILER_HPP
+
+#include "int.hpp"
+#include <array>
+#include <ostream>
+#include <vector>
+
+namespace nemu {
+
+enum ProfileAccess : uint8 {
+  PROFILE_READ,
+  PROFILE_WRITE,
+  PROFILE_EXECUTE,
+};
+
+// Count of every kind of access, indexed by ProfileAccess
+using ProfileCounts = std::array<uint64, 3>;
+
+enum class PpuRegion : uint8 {
+  PATTERN_0,
+  PATTERN_1,
+  NAMETABLE_0,
+  NAMETABLE_1,
+  NAMETABLE_2,
+  NAMETABLE_3,
+  PALETTE,
+};
+
+// Instruction executed the most, the address is the offset in the bank for the code of PRG memory
+struct HotSpot {
+  uint32 bank;
+  uint16 address;
+  uint64 executes;
+};
+
+// Header of a binary dump, followed by the CPU, PPU and PRG bank counters as they are laid out in memory
+struct ProfileHeader {
+  constexpr static uint32 MAGIC = 0x4652504E;  // "NPRF"
+  constexpr static uint16 VERSION = 1;
+
+  uint32 magic;
+  uint16 version;
+  uint16 banks;
+  int64 frame;
+};
+
+static_assert(sizeof(ProfileHeader) == 16);
+
+// Counters of the memory accesses of the console, in flat arrays indexed by address
+class Profiler {
+public:
+  // Size of the PRG windows the banks are counted in
+  constexpr static uint16 BANK_SIZE = 0x2000;
+
+  // Count an access of the CPU, the PRG bank is the tag of the window holding the address, zero when not PRG memory
+  inline void cpu(uint16 n, uint32 bank, ProfileAccess access) {
+    m_cpu[n][access]++;
+
+    if (bank) {
+      size_t index = size_t(bank - 1) * BANK_SIZE + (n & (BANK_SIZE - 1));
+
+      // The banks are only known once mapped, the counters grow with the highest bank seen
+      if (index >= m_prg.size()) [[unlikely]] {
+        m_prg.resize(size_t(bank) * BANK_SIZE);
+      }
+
+      m_prg[index][access]++;
+    }
+  }
+
+  // Count an access of the PPU, from the CPU data port or from the rendering
+  inline void ppu(uint16 n, ProfileAccess access) {
+    m_ppu[n & 0x3FFF][access]++;
+  }
+
+  static PpuRegion region(uint16 n);
+
+  // Sum of the accesses of every region of the PPU address space
+  std::array<ProfileCounts, 7> regions() const;
+
+  std::vector<HotSpot> hottest(size_t count) const;
+
+  // Start counting from zero again, once the counters of a frame are written
+  void reset();
+
+  // One row per address accessed, the frame column is left empty when negative
+  static void write_csv_header(std::ostream &output);
+  void write_csv(std::ostream &output, int64 frame = -1) const;
+
+  void write_binary(std::ostream &output, int64 frame = -1) const;
+
+  inline const auto &cpu() const {
+    return m_cpu;
+  }
+
+  inline const auto &ppu() const {
+    return m_ppu;
+  }
+
+  // Counters of the PRG bank tags from 1, BANK_SIZE entries per bank
+  inline const auto &prg() const {
+    return m_prg;
+  }
+
+private:
+  std::array<ProfileCounts, 0x10000> m_cpu {};
+  std::array<ProfileCounts, 0x4000> m_ppu {};
+  std::vector<ProfileCounts> m_prg;
+};
+
+}  // namespace nemu
+
+#endif
@@ -0,0 +1,153 @@
+#include "rewind.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace nemu {
+
+Rewind::Rewind(uint32 snapshots, uint32 interval, size_t memory) :
+  m_interval {std::max(1u, interval)},
+  m_data(memory),
+  m_entries(std::max(1u, snapshots)) {
+  clear();
+}
+
+void Rewind::record(const Nes &nes) {
+  if (m_frame++ % m_interval != 0) {
+    return;
+  }
+
+  if (m_current.empty()) {
+    m_current.resize(nes.state_size()), m_scratch.resize(m_current.size());
+    nes.save(m_current);
+    return;
+  }
+
+  nes.save(m_scratch);
+
+  // A delta that can't fit in the ring breaks the chain of snapshots
+  if (size_t bound = encoded_bound(m_scratch.size()); bound <= m_data.size()) {
+    uint8 *output = reserve(bound);
+    size_t size = encode(m_scratch, m_current, output);
+
+    m_entries[(m_first + m_count++) % m_entries.size()] = {m_head, size};
+    m_head += size;
+  } else {
+    m_count = 0;
+  }
+
+  std::swap(m_current, m_scratch);
+}
+
+bool Rewind::rewind(Nes &nes) {
+  if (m_current.empty()) {
+    return false;
+  }
+
+  nes.load(m_current);
+  m_frame = 1;
+
+  if (m_count == 0) {
+    return false;
+  }
+
+  // Step back to the snapshot before the restored one
+  const Entry &entry = m_entries[(m_first + --m_count) % m_entries.size()];
+  decode({&m_data[entry.offset], entry.size}, m_current);
+  m_head = entry.offset;
+
+  return true;
+}
+
+void Rewind::clear() {
+  m_frame = 0, m_head = 0, m_first = 0, m_count = 0;
+  m_current.clear();
+}
+
+size_t Rewind::memory() const {
+  size_t memory = 0;
+
+  for (uint32 n = 0; n < m_count; n++) {
+    memory += m_entries[(m_first + n) % m_entries.size()].size;
+  }
+
+  return memory;
+}
+
+uint8 *Rewind::reserve(size_t size) {
+  if (m_count == m_entries.size()) {
+    drop_oldest();
+  }
+
+  // Wrap around, the entries left at the end of the buffer are the oldest ones
+  if (m_head + size > m_data.size()) {
+    while (m_count && m_entries[m_first].offset >= m_head) {
+      drop_oldest();
+    }
+
+    m_head = 0;
+  }
+
+  while (m_count && m_entries[m_first].offset >= m_head && m_entries[m_first].offset < m_head + size) {
+    drop_oldest();
+  }
+
+  return &m_data[m_head];
+}
+
+void Rewind::drop_oldest() {
+  m_first = (m_first + 1) % m_entries.size(), m_count--;
+}
+
+size_t Rewind::encode(std::span<const std::byte> a, std::span<const std::byte> b, uint8 *output) {
+  const uint8 *begin = output;
+  size_t n = 0;
+
+  auto unchanged = [&](size_t n) {
+    return a[n] == b[n];
+  };
+
+  while (n < a.size()) {
+    uint8 skip = 0, count = 0;
+
+    // Compare whole words while the states are unchanged, most of them are
+    while (skip <= 0xFF - 8 && n + 8 <= a.size() && std::memcmp(&a[n], &b[n], 8) == 0) {
+      skip += 8, n += 8;
+    }
+
+    while (skip < 0xFF && n < a.size() && unchanged(n)) {
+      skip++, n++;
+    }
+
+    // A single unchanged byte is cheaper as a literal than as a new run
+    uint8 *literals = output + 2;
+
+    while (count < 0xFF && n < a.size() && !(unchanged(n) && (n + 1 == a.size() || unchanged(n + 1)))) {
+      literals[count++] = std::to_integer<uint8>(a[n] ^ b[n]), n++;
+    }
+
+    output[0] = skip, output[1] = count;
+    output += 2 + count;
+  }
+
+  return output - begin;
+}
+
+void Rewind::decode(std::span<const uint8> delta, std::span<std::byte> state) {
+  size_t n = 0;
+
+  for (size_t p = 0; p < delta.size();) {
+    uint8 skip = delta[p++], count = delta[p++];
+    n += skip;
+
+    for (uint8 k = 0; k < count; k++) {
+      state[n++] ^= std::byte {delta[p++]};
+    }
+  }
+}
+
+size_t Rewind::encoded_bound(size_t size) {
+  // Every run but the first skips at least two bytes or holds a full run of literals
+  return size + 2 * (size / 0xFF + 2);
+}
+
+}  // namespace nemu
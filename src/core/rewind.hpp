@@ -0,0 +1,58 @@
+#ifndef NEMU_REWIND_HPP
+#define NEMU_REWIND_HPP
+
+#include "nes.hpp"
+#include <span>
+#include <vector>
+
+namespace nemu {
+
+// Snapshots of the console taken every few frames into fixed-size rings. Only the latest snapshot
+// is kept whole, every entry of the ring is the delta to the snapshot before it
+class Rewind {
+public:
+  Rewind(uint32 snapshots, uint32 interval, size_t memory);
+
+  // Called once per frame, the console is snapshot every interval frames
+  void record(const Nes &nes);
+
+  // Restore the latest snapshot and drop it, false once only the oldest snapshot is left
+  bool rewind(Nes &nes);
+
+  void clear();
+
+  inline uint32 snapshots() const {
+    return m_count + !m_current.empty();
+  }
+
+  // Bytes held by the deltas
+  size_t memory() const;
+
+private:
+  struct Entry {
+    size_t offset, size;
+  };
+
+  // Room for the delta of the given size, the oldest entries are dropped to make it
+  uint8 *reserve(size_t size);
+  void drop_oldest();
+
+  // Deltas are the XOR of two states, encoded as runs of unchanged bytes followed by runs of literals
+  static size_t encode(std::span<const std::byte> a, std::span<const std::byte> b, uint8 *output);
+  static void decode(std::span<const uint8> delta, std::span<std::byte> state);
+  static size_t encoded_bound(size_t size);
+
+  uint32 m_interval, m_frame;
+
+  std::vector<std::byte> m_current, m_scratch;
+
+  std::vector<uint8> m_data;
+  size_t m_head;
+
+  std::vector<Entry> m_entries;
+  uint32 m_first, m_count;
+};
+
+}  // namespace nemu
+
+#endif
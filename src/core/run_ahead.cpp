@@ -0,0 +1,30 @@
+#include "run_ahead.hpp"
+
+namespace nemu {
+
+void RunAhead::run(Nes &nes) {
+  if (m_frames == 0) {
+    nes.run_frame();
+    return;
+  }
+
+  // Only the last frame ahead is presented, the others are not rendered
+  nes.ppu().set_rendering(false);
+  nes.run_frame();
+
+  auto begin = std::chrono::steady_clock::now();
+
+  m_state.resize(nes.state_size());
+  nes.save(m_state);
+
+  for (uint32 n = 1; n <= m_frames; n++) {
+    nes.ppu().set_rendering(n == m_frames);
+    nes.run_frame();
+  }
+
+  nes.load(m_state);
+
+  m_overhead += std::chrono::steady_clock::now() - begin, m_count++;
+}
+
+}  // namespace nemu
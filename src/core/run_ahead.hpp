@@ -0,0 +1,38 @@
+#ifndef NEMU_RUN_AHEAD_HPP
+#define NEMU_RUN_AHEAD_HPP
+
+#include "nes.hpp"
+#include <chrono>
+#include <vector>
+
+namespace nemu {
+
+// Emulate a few frames ahead of the console with the current input and present the last one, then
+// restore the console so the next input still applies to the frame that follows the real one
+class RunAhead {
+public:
+  RunAhead(uint32 frames) : m_frames {frames} {}
+
+  // Run a frame of the console then run ahead of it, the canvas holds the frame to present
+  void run(Nes &nes);
+
+  inline uint32 frames() const {
+    return m_frames;
+  }
+
+  // Average time spent saving, running ahead and restoring per presented frame
+  inline std::chrono::duration<f64, std::milli> overhead() const {
+    return m_count ? m_overhead / m_count : decltype(m_overhead) {};
+  }
+
+private:
+  uint32 m_frames;
+  std::vector<std::byte> m_state;
+
+  std::chrono::duration<f64, std::milli> m_overhead {};
+  uint64 m_count {};
+};
+
+}  // namespace nemu
+
+#endif
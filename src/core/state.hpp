@@ -0,0 +1,89 @@
+#ifndef NEMU_STATE_HPP
+#define NEMU_STATE_HPP
+
+#include "exception.hpp"
+#include "int.hpp"
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+namespace nemu {
+
+// A save-state is this header followed by the raw bytes of every component, in a fixed order
+struct StateHeader {
+  constexpr static uint32 MAGIC = 0x5453454E;  // "NEST"
+  constexpr static uint16 VERSION = 2;
+
+  uint32 magic;
+  uint16 version;
+  uint8 mapper;
+  uint8 _;
+  uint32 size;
+  uint32 rom_crc;  // CRC-32 of the PRG then the CHR data of the cartridge
+};
+
+template<typename T>
+concept StateData = std::is_trivially_copyable_v<T>;
+
+class StateWriter {
+public:
+  // Without a buffer the writer only counts the bytes a save-state takes
+  StateWriter() = default;
+  StateWriter(std::span<std::byte> buffer) : m_buffer {buffer} {}
+
+  template<StateData T>
+  inline void write(const T &data) {
+    write(std::as_bytes(std::span {&data, 1}));
+  }
+
+  inline void write(std::span<const std::byte> data) {
+    if (m_buffer.data()) {
+      if (m_size + data.size() > m_buffer.size()) {
+        throw Exception {"Save-state buffer too small: {} bytes", m_buffer.size()};
+      }
+
+      std::memcpy(m_buffer.data() + m_size, data.data(), data.size());
+    }
+
+    m_size += data.size();
+  }
+
+  inline size_t size() const {
+    return m_size;
+  }
+
+private:
+  std::span<std::byte> m_buffer;
+  size_t m_size {};
+};
+
+class StateReader {
+public:
+  StateReader(std::span<const std::byte> buffer) : m_buffer {buffer} {}
+
+  template<StateData T>
+  inline void read(T &data) {
+    read(std::as_writable_bytes(std::span {&data, 1}));
+  }
+
+  inline void read(std::span<std::byte> data) {
+    if (m_size + data.size() > m_buffer.size()) {
+      throw Exception {"Truncated save-state: {} bytes", m_buffer.size()};
+    }
+
+    std::memcpy(data.data(), m_buffer.data() + m_size, data.size());
+    m_size += data.size();
+  }
+
+  inline size_t size() const {
+    return m_size;
+  }
+
+private:
+  std::span<const std::byte> m_buffer;
+  size_t m_size {};
+};
+
+}  // namespace nemu
+
+#endif
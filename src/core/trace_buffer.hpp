@@ -0,0 +1,72 @@
+#ifndef NEMU_TRACE_BUFFER_HPP
+#define NEMU_TRACE_BUFFER_HPP
+
+#include "int.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <span>
+#include <thread>
+
+namespace nemu {
+
+// Fixed-size binary record of an instruction, taken before it executes
+struct TraceRecord {
+  uint64 cycle;
+  uint16 pc;
+  uint8 opcode, operands[2], size;
+  uint8 a, x, y, p, sp;
+  int16 scanline;
+  uint16 dot;
+};
+
+static_assert(sizeof(TraceRecord) == 24);
+
+// Lock-free ring of trace records between the emulation thread and a single consumer thread
+class TraceBuffer {
+public:
+  // The capacity is rounded up to a power of two
+  TraceBuffer(size_t capacity = 1 << 20) :
+    m_mask {std::bit_ceil(capacity) - 1}, m_records {std::make_unique<TraceRecord[]>(m_mask + 1)} {}
+
+  // Wait for the consumer when the ring is full, a trace is useless with holes
+  inline void push(const TraceRecord &record) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+
+    // The head is only reloaded when the ring looks full
+    while (tail - m_head_cache > m_mask) {
+      if (m_head_cache = m_head.load(std::memory_order_acquire); tail - m_head_cache > m_mask) {
+        std::this_thread::yield();
+      }
+    }
+
+    m_records[tail & m_mask] = record;
+    m_tail.store(tail + 1, std::memory_order_release);
+  }
+
+  // Move the records available into the output, returns the count of records moved
+  inline size_t pop(std::span<TraceRecord> output) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t count = std::min(m_tail.load(std::memory_order_acquire) - head, output.size());
+
+    for (size_t n = 0; n < count; n++) {
+      output[n] = m_records[(head + n) & m_mask];
+    }
+
+    m_head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+private:
+  size_t m_mask;
+  std::unique_ptr<TraceRecord[]> m_records;
+
+  alignas(64) std::atomic<size_t> m_head {};
+  alignas(64) std::atomic<size_t> m_tail {};
+  size_t m_head_cache {};
+};
+
+}  // namespace nemu
+
+#endif
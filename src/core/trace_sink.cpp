@@ -0,0 +1,115 @@
+#include "trace_sink.hpp"
+#include "cpu/instructions.hpp"
+#include "exception.hpp"
+#include <array>
+#include <chrono>
+
+namespace nemu {
+
+// Records moved out of the ring at once
+constexpr size_t DRAIN_BATCH = 4096;
+
+TraceSink::TraceSink(TraceBuffer &buffer, std::string_view path, Format format) :
+  m_buffer {buffer}, m_format {format}, m_fstream {&path[0], std::ios::binary} {
+  if (!m_fstream) {
+    throw Exception {"Can't write trace file to: '{}'", path};
+  }
+
+  m_thread = std::jthread {[this](std::stop_token stop) { drain(stop); }};
+}
+
+TraceSink::~TraceSink() {
+  stop();
+}
+
+void TraceSink::stop() {
+  if (m_thread.joinable()) {
+    m_thread.request_stop();
+    m_thread.join();
+  }
+}
+
+// Fixed-width part of a line, filled in place since the text is produced at the speed of the emulation
+constexpr std::string_view LINE_TEMPLATE =
+  "0000  00 00 00  ???                             A:00 X:00 Y:00 P:00 SP:00 PPU:  0,  0 CYC:";
+
+static void write_hex(char *output, uint32 value, uint8 digits) {
+  for (uint8 n = digits; n-- > 0; value >>= 4) {
+    output[n] = "0123456789ABCDEF"[value & 0xF];
+  }
+}
+
+static void write_decimal(char *output, uint32 value, uint8 width) {
+  for (uint8 n = width; n-- > 0; value /= 10) {
+    output[n] = n + 1 < width && !value ? ' ' : char('0' + value % 10);
+  }
+}
+
+void TraceSink::format(const TraceRecord &record, fmt::memory_buffer &output) {
+  char line[LINE_TEMPLATE.size()];
+  std::ranges::copy(LINE_TEMPLATE, line);
+
+  write_hex(&line[0], record.pc, 4);
+  write_hex(&line[6], record.opcode, 2);
+
+  for (uint8 n = 0; n < 2; n++) {
+    if (n + 1 < record.size) {
+      write_hex(&line[9 + 3 * n], record.operands[n], 2);
+    } else {
+      line[9 + 3 * n] = line[10 + 3 * n] = ' ';
+    }
+  }
+
+  std::string_view mnemonic = fmt::formatter<cpu::Mnemonic> {}.name(cpu::INSTRUCTION_SET[record.opcode].mnemonic);
+  std::ranges::copy(mnemonic.substr(0, 3), &line[16]);
+
+  write_hex(&line[50], record.a, 2);
+  write_hex(&line[55], record.x, 2);
+  write_hex(&line[60], record.y, 2);
+  write_hex(&line[65], record.p, 2);
+  write_hex(&line[71], record.sp, 2);
+
+  // The log numbers the pre-render scanline after the last one
+  write_decimal(&line[78], record.scanline < 0 ? 261 : record.scanline, 3);
+  write_decimal(&line[82], record.dot, 3);
+
+  output.append(line, line + sizeof(line));
+  fmt::format_to(std::back_inserter(output), "{}\n", record.cycle);
+}
+
+void TraceSink::drain(std::stop_token stop) {
+  std::array<TraceRecord, DRAIN_BATCH> records;
+
+  // The ring is emptied once more after the stop request, nothing is pushed anymore by then
+  for (bool stopping = false; !stopping;) {
+    stopping = stop.stop_requested();
+
+    while (size_t count = m_buffer.pop(records)) {
+      write({records.data(), count});
+    }
+
+    if (!stopping) {
+      std::this_thread::sleep_for(std::chrono::milliseconds {1});
+    }
+  }
+
+  m_fstream.flush();
+}
+
+void TraceSink::write(std::span<const TraceRecord> records) {
+  if (m_format == Format::BINARY) {
+    m_fstream.write(reinterpret_cast<const char *>(records.data()), records.size_bytes());
+  } else {
+    m_text.clear();
+
+    for (const TraceRecord &record : records) {
+      format(record, m_text);
+    }
+
+    m_fstream.write(m_text.data(), m_text.size());
+  }
+
+  m_records.fetch_add(records.size(), std::memory_order_relaxed);
+}
+
+}  // namespace nemu
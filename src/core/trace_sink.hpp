@@ -0,0 +1,46 @@
+#ifndef NEMU_TRACE_SINK_HPP
+#define NEMU_TRACE_SINK_HPP
+
+#include "trace_buffer.hpp"
+#include <fmt/format.h>
+#include <fstream>
+#include <string_view>
+#include <thread>
+
+namespace nemu {
+
+// Drain the records of a trace buffer into a file from a background thread
+class TraceSink {
+public:
+  // Binary files are the raw records, text files are formatted like the nestest log
+  enum class Format { BINARY, TEXT };
+
+  TraceSink(TraceBuffer &buffer, std::string_view path, Format format = Format::BINARY);
+
+  ~TraceSink();
+
+  // Write the records left once the emulation has stopped pushing, and close the thread
+  void stop();
+
+  // Format a record as a line of the nestest log, the disassembly is reduced to the mnemonic
+  static void format(const TraceRecord &record, fmt::memory_buffer &output);
+
+  inline uint64 records() const {
+    return m_records.load(std::memory_order_relaxed);
+  }
+
+private:
+  void drain(std::stop_token stop);
+  void write(std::span<const TraceRecord> records);
+
+  TraceBuffer &m_buffer;
+  Format m_format;
+  std::ofstream m_fstream;
+  fmt::memory_buffer m_text;
+  std::atomic<uint64> m_records {};
+  std::jthread m_thread;
+};
+
+}  // namespace nemu
+
+#endif
@@ -0,0 +1,249 @@
+#include "golden_log.hpp"
+#include "exception.hpp"
+#include "nes.hpp"
+#include "trace_sink.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nemu {
+
+// Columns of a nestest log line, the disassembly between the bytes and the registers is skipped
+enum Column : uint8 {
+  PC = 0,
+  BYTES = 6,
+  A = 50,
+  X = 55,
+  Y = 60,
+  P = 65,
+  SP = 71,
+  SCANLINE = 78,
+  DOT = 82,
+  CYCLE = 90,
+};
+
+// The break and unused flags only exist on the stack, emulators disagree on their value in the register
+constexpr uint8 STATUS_MASK = 0xCF;
+
+constexpr int64 SCANLINE_TICKS = 341, FRAME_TICKS = 262 * SCANLINE_TICKS;
+
+template<typename T>
+static bool parse_hex(const char *text, uint8 digits, T &value) {
+  value = 0;
+
+  for (uint8 n = 0; n < digits; n++) {
+    char c = text[n];
+    uint8 digit = c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 0xFF;
+
+    if (digit == 0xFF) {
+      return false;
+    }
+
+    value = T(value << 4 | digit);
+  }
+
+  return true;
+}
+
+// Right-aligned decimal number padded with spaces
+template<typename T>
+static bool parse_decimal(const char *begin, const char *end, T &value) {
+  for (; begin < end && *begin == ' '; begin++) {}
+
+  value = 0;
+
+  if (begin == end) {
+    return false;
+  }
+
+  for (; begin < end; begin++) {
+    if (*begin < '0' || *begin > '9') {
+      return false;
+    }
+
+    value = T(value * 10 + (*begin - '0'));
+  }
+
+  return true;
+}
+
+// Tick of the frame the record was taken at, the pre-render scanline is the last one as in the log
+static int64 position(const TraceRecord &record) {
+  return (record.scanline < 0 ? 261 : record.scanline) * SCANLINE_TICKS + record.dot;
+}
+
+GoldenLog::GoldenLog(std::string_view path, bool timing) : m_path {path}, m_timing {timing} {
+  int fd = ::open(&path[0], O_RDONLY);
+  struct stat status;
+
+  if (fd < 0) {
+    throw Exception {"Can't open golden log from: '{}'", path};
+  }
+
+  if (::fstat(fd, &status) < 0) {
+    ::close(fd);
+    throw Exception {"Can't open golden log from: '{}'", path};
+  }
+
+  m_size = status.st_size;
+
+  if (m_size) {
+    void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw Exception {"Can't map golden log from: '{}'", path};
+    }
+
+    // The log is read once from the start to the end
+    ::madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char *>(data);
+  }
+
+  ::close(fd);
+  m_line = m_data, m_end = m_data + m_size;
+}
+
+GoldenLog::~GoldenLog() {
+  if (m_data) {
+    ::munmap(const_cast<char *>(m_data), m_size);
+  }
+}
+
+void GoldenLog::start(Nes &nes) const {
+  if (finished()) {
+    return;
+  }
+
+  TraceRecord first = parse_line(m_line).record;
+
+  nes.cpu().set_registers({
+    .status = {first.p},
+    .a = first.a,
+    .x = first.x,
+    .y = first.y,
+    .sp = first.sp,
+    .pc = first.pc,
+  });
+}
+
+void GoldenLog::compare(std::span<const TraceRecord> records) {
+  for (const TraceRecord &record : records) {
+    if (finished()) {
+      return;
+    }
+
+    auto [expected, end] = parse_line(m_line);
+
+    if (m_lines == 0) {
+      m_cycle_offset = int64(expected.cycle) - int64(record.cycle);
+      m_position_offset = position(expected) - position(record);
+    }
+
+    if (record.pc != expected.pc) {
+      diverge(record, "PC");
+    }
+
+    if (record.opcode != expected.opcode || record.size != expected.size) {
+      diverge(record, "opcode");
+    }
+
+    for (uint8 n = 0; n + 1 < record.size; n++) {
+      if (record.operands[n] != expected.operands[n]) {
+        diverge(record, "operand");
+      }
+    }
+
+    if (record.a != expected.a) {
+      diverge(record, "A");
+    } else if (record.x != expected.x) {
+      diverge(record, "X");
+    } else if (record.y != expected.y) {
+      diverge(record, "Y");
+    } else if ((record.p ^ expected.p) & STATUS_MASK) {
+      diverge(record, "P");
+    } else if (record.sp != expected.sp) {
+      diverge(record, "SP");
+    }
+
+    if (m_timing && int64(record.cycle) + m_cycle_offset != int64(expected.cycle)) {
+      diverge(record, "CYC");
+    }
+
+    if (m_timing && (position(record) + m_position_offset - position(expected)) % FRAME_TICKS) {
+      diverge(record, "PPU");
+    }
+
+    std::shift_left(std::begin(m_history), std::end(m_history), 1);
+    m_history[std::size(m_history) - 1] = m_line;
+
+    m_line = end < m_end ? end + 1 : m_end, m_lines++;
+  }
+}
+
+GoldenLog::Line GoldenLog::parse_line(const char *line) const {
+  const char *end = static_cast<const char *>(std::memchr(line, '\n', m_end - line));
+  end = end ? end : m_end;
+
+  const char *cycle_end = end > line && end[-1] == '\r' ? end - 1 : end;
+
+  TraceRecord record {};
+  bool valid = cycle_end - line > CYCLE && std::memcmp(&line[A - 2], "A:", 2) == 0 &&
+               std::memcmp(&line[SCANLINE - 4], "PPU:", 4) == 0 && std::memcmp(&line[CYCLE - 4], "CYC:", 4) == 0;
+
+  valid = valid && parse_hex(&line[PC], 4, record.pc) && parse_hex(&line[BYTES], 2, record.opcode);
+  record.size = 1;
+
+  // Operands are left blank past the size of the instruction
+  for (uint8 n = 0; valid && n < 2 && line[BYTES + 3 * (n + 1)] != ' '; n++) {
+    valid = parse_hex(&line[BYTES + 3 * (n + 1)], 2, record.operands[n]), record.size++;
+  }
+
+  valid = valid && parse_hex(&line[A], 2, record.a) && parse_hex(&line[X], 2, record.x) &&
+          parse_hex(&line[Y], 2, record.y) && parse_hex(&line[P], 2, record.p) && parse_hex(&line[SP], 2, record.sp);
+
+  valid = valid && parse_decimal(&line[SCANLINE], &line[SCANLINE + 3], record.scanline) &&
+          parse_decimal(&line[DOT], &line[DOT + 3], record.dot) && parse_decimal(&line[CYCLE], cycle_end, record.cycle);
+
+  if (!valid) {
+    throw Exception {"Unsupported format at line {} of the golden log: '{}'", m_lines + 1, m_path};
+  }
+
+  return {record, end};
+}
+
+void GoldenLog::diverge(const TraceRecord &record, std::string_view column) const {
+  std::string context;
+
+  for (const char *line : m_history) {
+    if (line) {
+      context += fmt::format("    {}\n", std::string_view {line, parse_line(line).end});
+    }
+  }
+
+  // Shift the clocks of the record to the ones of the log for the comparison
+  TraceRecord actual = record;
+  int64 ticks = ((position(record) + m_position_offset) % FRAME_TICKS + FRAME_TICKS) % FRAME_TICKS;
+
+  actual.cycle = record.cycle + m_cycle_offset;
+  actual.scanline = int16(ticks / SCANLINE_TICKS), actual.dot = uint16(ticks % SCANLINE_TICKS);
+
+  fmt::memory_buffer output;
+  TraceSink::format(actual, output);
+
+  throw Exception {
+    "Divergence on {} at line {} of the golden log: '{}'\n{}  - {}\n  + {}",
+    column,
+    m_lines + 1,
+    m_path,
+    context,
+    std::string_view {m_line, parse_line(m_line).end},
+    std::string_view {output.data(), output.size() - 1},
+  };
+}
+
+}  // namespace nemu
@@ -0,0 +1,62 @@
+#ifndef NEMU_GOLDEN_LOG_HPP
+#define NEMU_GOLDEN_LOG_HPP
+
+#include "trace_buffer.hpp"
+#include <span>
+#include <string_view>
+
+namespace nemu {
+
+class Nes;
+
+// Reference CPU trace in the nestest log format, mapped in memory and parsed in place
+class GoldenLog {
+public:
+  // Without timing, the cycle and PPU columns are ignored
+  GoldenLog(std::string_view path, bool timing = true);
+  ~GoldenLog();
+
+  GoldenLog(const GoldenLog &) = delete;
+  GoldenLog &operator=(const GoldenLog &) = delete;
+
+  // Bring the registers of the initialized console to the state of the first line
+  void start(Nes &nes) const;
+
+  // Compare the records with the next lines of the log, throws at the first divergence
+  void compare(std::span<const TraceRecord> records);
+
+  inline bool finished() const {
+    return m_line == m_end;
+  }
+
+  inline uint64 lines() const {
+    return m_lines;
+  }
+
+private:
+  // Columns of a line, the operands past the size of the instruction are zero
+  struct Line {
+    TraceRecord record;
+    const char *end;
+  };
+
+  Line parse_line(const char *line) const;
+  [[noreturn]] void diverge(const TraceRecord &record, std::string_view column) const;
+
+  std::string_view m_path;
+  bool m_timing;
+
+  const char *m_data {}, *m_end {};
+  size_t m_size {};
+
+  // The last lines compared are kept for the context of a divergence
+  const char *m_line {}, *m_history[4] {};
+  uint64 m_lines {};
+
+  // Offsets between the clocks of the log and of the console, taken on the first line
+  int64 m_cycle_offset {}, m_position_offset {};
+};
+
+}  // namespace nemu
+
+#endif
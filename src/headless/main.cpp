@@ -0,0 +1,483 @@
+#include "exception.hpp"
+#include "golden_log.hpp"
+#include "movie.hpp"
+#include "nes.hpp"
+#include "perf_counters.hpp"
+#include "run_ahead.hpp"
+#include "script.hpp"
+#include "trace_sink.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace nemu;
+
+constexpr std::string_view CLI_USAGE = R"(
+NEMU headless runner usage:
+  > nemu_headless <rom path> [options]
+    - rom path: The rom must be in the iNES 1.0 header format.
+    - --frames <n>: Run n frames as fast as possible, 600 by default.
+    - --cycles <n>: Run whole frames until a budget of n CPU cycles is reached instead of a count of frames.
+    - --input <path>: Input script, one '<frame> <gamepad> <buttons...>' entry per line (ex: '120 0 START').
+    - --run-ahead <n>: Run n frames ahead of each frame like the app does, and report the overhead.
+    - --record <path>: Record the input of every frame and the RAM and framebuffer checksums into a movie.
+    - --load-state <path>: Start from a save-state instead of power-on, a movie recorded starts from it too.
+    - --save-state <path>: Write a save-state of the console once the run is over.
+    - --replay <path>: Replay a movie instead of the options above, stopping at the first desync.
+    - --trace <path>: Write a binary record of every instruction executed, needs a NEMU_TRACE build.
+    - --trace-text <path>: Same as --trace, but the records are formatted like the nestest log.
+    - --golden <path>: Compare every instruction with a nestest format log until its end, stopping at the first divergence.
+    - --golden-untimed <path>: Same as --golden, but the CYC and PPU columns are ignored.
+    - --profile <path>: Write the counters of the memory accesses in binary, needs a NEMU_PROFILE build.
+    - --profile-csv <path>: Same as --profile, but one CSV row is written per address accessed.
+    - --profile-dump <run|frame>: Write the counters once at the end of the run, or for every frame, run by default.
+    - --timings <path>: Time the CPU, the PPU and the rendering of every frame, and write their percentiles in JSON.
+    - --perf <off|on>: Count the host cycles, instructions, branch and cache misses of every frame with perf_event_open.
+    - --break <address>: Stop before the instruction at the hexadecimal address runs, and print the CPU state.
+    - --watch <address>: Stop after an instruction writing to the hexadecimal address, and print the CPU state.
+)";
+
+struct Options {
+  std::string_view rom_path;
+  uint64 frames = 600, cycles = UINT64_MAX;
+  std::optional<std::string_view> input_path;
+  uint32 run_ahead = 0;
+  std::optional<std::string_view> record_path, replay_path;
+  std::optional<std::string_view> load_state_path, save_state_path;
+  std::optional<std::string_view> trace_path;
+  TraceSink::Format trace_format = TraceSink::Format::BINARY;
+  std::optional<std::string_view> golden_path;
+  bool golden_timing = true;
+  std::vector<Breakpoint> breakpoints;
+  std::optional<std::string_view> profile_path, timings_path;
+  bool profile_csv = false, profile_frames = false;
+  bool perf = false;
+};
+
+Options parse_options(std::span<const char *> args) {
+  Options options {};
+  options.rom_path = args[0];
+
+  for (size_t n = 1; n < args.size(); n += 2) {
+    std::string_view option = args[n];
+
+    if (n + 1 >= args.size()) {
+      throw Exception {"Missing value for the option '{}'", option};
+    }
+
+    std::string_view value = args[n + 1];
+
+    if (option == "--frames") {
+      options.frames = std::stoull(std::string {value}), options.cycles = UINT64_MAX;
+    } else if (option == "--cycles") {
+      options.frames = UINT64_MAX, options.cycles = std::stoull(std::string {value});
+    } else if (option == "--input") {
+      options.input_path = value;
+    } else if (option == "--run-ahead") {
+      options.run_ahead = std::stoul(std::string {value});
+    } else if (option == "--record") {
+      options.record_path = value;
+    } else if (option == "--replay") {
+      options.replay_path = value;
+    } else if (option == "--load-state") {
+      options.load_state_path = value;
+    } else if (option == "--save-state") {
+      options.save_state_path = value;
+    } else if (option == "--trace" || option == "--trace-text") {
+      options.trace_path = value;
+      options.trace_format = option == "--trace" ? TraceSink::Format::BINARY : TraceSink::Format::TEXT;
+    } else if (option == "--profile" || option == "--profile-csv") {
+      options.profile_path = value, options.profile_csv = option == "--profile-csv";
+    } else if (option == "--profile-dump" && (value == "run" || value == "frame")) {
+      options.profile_frames = value == "frame";
+    } else if (option == "--perf" && (value == "off" || value == "on")) {
+      options.perf = value == "on";
+    } else if (option == "--timings") {
+      options.timings_path = value;
+    } else if (option == "--break" || option == "--watch") {
+      uint16 address = std::stoul(std::string {value}, nullptr, 16);
+      options.breakpoints.push_back({
+        .access = option == "--break" ? DEBUG_EXECUTE : DEBUG_WRITE,
+        .begin = address,
+        .end = address,
+      });
+    } else if (option == "--golden" || option == "--golden-untimed") {
+      options.golden_path = value, options.golden_timing = option == "--golden";
+    } else {
+      throw Exception {"Invalid option '{} {}'", option, value};
+    }
+  }
+
+  // The framebuffer checksums are taken from the frame presented
+  if (options.run_ahead && (options.record_path || options.replay_path)) {
+    throw Exception {"Movies can't be recorded or replayed with run-ahead"};
+  }
+
+  // A movie holds the state it starts from
+  if (options.replay_path && options.load_state_path) {
+    throw Exception {"A movie is replayed from its own start, not from a save-state"};
+  }
+
+  // Both consume the trace buffer, and the frames run ahead would be traced too
+  if (options.golden_path && (options.trace_path || options.run_ahead)) {
+    throw Exception {"A golden log can't be compared with tracing or run-ahead enabled"};
+  }
+
+#ifndef NEMU_TRACE
+  if (options.trace_path || options.golden_path) {
+    throw Exception {"Tracing needs a build configured with NEMU_TRACE"};
+  }
+#endif
+
+#ifndef NEMU_PROFILE
+  if (options.profile_path) {
+    throw Exception {"Profiling needs a build configured with NEMU_PROFILE"};
+  }
+#endif
+
+  return options;
+}
+
+std::vector<uint8> parse_rom(std::string_view path) {
+  std::ifstream fstream {&path[0], std::ios::binary};
+
+  if (!fstream) {
+    throw Exception {"Can't open rom file from: '{}'", path};
+  }
+
+  return {
+    std::istreambuf_iterator<char>(fstream),
+    {},
+  };
+}
+
+void load_state(Nes &nes, std::string_view path) {
+  std::ifstream fstream {&path[0], std::ios::binary};
+
+  if (!fstream) {
+    throw Exception {"Can't open save-state file from: '{}'", path};
+  }
+
+  std::vector<char> data {std::istreambuf_iterator<char>(fstream), {}};
+  nes.load(std::as_bytes(std::span {data}));
+}
+
+void save_state(const Nes &nes, std::string_view path) {
+  std::vector<std::byte> buffer(nes.state_size());
+  size_t size = nes.save(buffer);
+
+  std::ofstream fstream {&path[0], std::ios::binary};
+
+  if (!fstream) {
+    throw Exception {"Can't write save-state file to: '{}'", path};
+  }
+
+  fstream.write(reinterpret_cast<const char *>(buffer.data()), size);
+}
+
+// FNV-1a, enough to compare the final state of two runs
+uint64 hash(std::span<const uint8> data, uint64 seed = 0xCBF29CE484222325) {
+  for (uint8 byte : data) {
+    seed = (seed ^ byte) * 0x100000001B3;
+  }
+
+  return seed;
+}
+
+void run(const Options &options) {
+  auto rom_data = parse_rom(options.rom_path);
+  Rom rom {rom_data};
+
+  // The console is too large for the stack
+  auto nes = std::make_unique<Nes>(rom);
+  auto script = options.input_path ? Script::parse_file(*options.input_path) : Script {};
+  auto movie = options.replay_path ? Movie::parse_file(*options.replay_path) : Movie::power_on();
+  RunAhead run_ahead {options.run_ahead};
+
+  nes->init();
+
+  // Replayed, the movie loads the same state on the freshly initialized console
+  if (options.load_state_path) {
+    load_state(*nes, *options.load_state_path), movie = Movie::from_state(*nes);
+  }
+
+  for (const Breakpoint &breakpoint : options.breakpoints) {
+    nes->add_breakpoint(breakpoint);
+  }
+
+  TraceBuffer trace_buffer;
+  std::optional<TraceSink> trace_sink;
+  std::optional<GoldenLog> golden_log;
+  std::vector<TraceRecord> golden_records(4096);
+
+  // The counters take a few MB
+  std::unique_ptr<Profiler> profiler;
+  std::ofstream profile_fstream;
+
+#ifdef NEMU_PROFILE
+  if (options.profile_path) {
+    profile_fstream.open(&(*options.profile_path)[0], std::ios::binary);
+
+    if (!profile_fstream) {
+      throw Exception {"Can't write profile file to: '{}'", *options.profile_path};
+    }
+
+    if (options.profile_csv) {
+      Profiler::write_csv_header(profile_fstream);
+    }
+
+    profiler = std::make_unique<Profiler>();
+    nes->set_profiler(profiler.get());
+  }
+#endif
+
+  // The percentiles cover the whole run, up to the last 65536 frames
+  FrameTime frame_time {};
+  FrameTimings timings {options.timings_path ? std::min<uint64>(options.frames, 1 << 16) : 1};
+
+  if (options.timings_path) {
+    nes->set_timings(&frame_time);
+  }
+
+  // Only the frames are counted, not the input scripts, the checks and the outputs around them
+  std::optional<PerfCounters> perf_counters;
+  PerfCounts perf_counts {};
+
+  if (options.perf) {
+    perf_counters.emplace();
+  }
+
+  auto dump_profile = [&](int64 frame) {
+    if (options.profile_csv) {
+      profiler->write_csv(profile_fstream, frame);
+    } else {
+      profiler->write_binary(profile_fstream, frame);
+    }
+  };
+
+#ifdef NEMU_TRACE
+  if (options.trace_path) {
+    trace_sink.emplace(trace_buffer, *options.trace_path, options.trace_format);
+    nes->set_trace(&trace_buffer);
+  }
+
+  if (options.golden_path) {
+    golden_log.emplace(*options.golden_path, options.golden_timing);
+    nes->set_trace(&trace_buffer);
+  }
+#endif
+
+  uint64 frame_limit = options.frames;
+
+  if (options.replay_path) {
+    movie.start(*nes), frame_limit = movie.frames();
+  }
+
+  // Run until the end of the log, a frame is far from filling the trace buffer
+  if (golden_log) {
+    golden_log->start(*nes), frame_limit = UINT64_MAX;
+  }
+
+  // Counted from the start of the run, a save-state or a movie may start well after power-on
+  uint64 cycles_begin = nes->cycles(), frames = 0, instructions = 0;
+  auto begin = std::chrono::steady_clock::now();
+
+  for (uint64 frame = 0; frame < frame_limit && nes->cycles() - cycles_begin < options.cycles; frame++) {
+    if (options.replay_path) {
+      movie.apply(*nes, frame);
+    } else {
+      script.apply(*nes, frame);
+    }
+
+    if (perf_counters) {
+      perf_counters->start();
+    }
+
+    // The counter wraps, a frame is far from it. The frames run ahead are restored and not counted
+    uint32 instruction_counter = nes->cpu().instruction_counter();
+    run_ahead.run(*nes);
+    instructions += uint32(nes->cpu().instruction_counter() - instruction_counter), frames++;
+
+    if (perf_counters) {
+      perf_counts += perf_counters->stop();
+    }
+
+    if (options.timings_path) {
+      timings.push(std::exchange(frame_time, {}));
+    }
+
+    if (profiler && options.profile_frames) {
+      dump_profile(frame), profiler->reset();
+    }
+
+    if (nes->debugger().hit()) {
+      break;
+    }
+
+    if (golden_log) {
+      while (size_t count = trace_buffer.pop(golden_records)) {
+        golden_log->compare({golden_records.data(), count});
+      }
+
+      if (golden_log->finished()) {
+        break;
+      }
+    }
+
+    if (options.replay_path && !movie.check(*nes, frame)) {
+      throw Exception {"Replay desync at frame {} of the movie: '{}'", frame, *options.replay_path};
+    }
+
+    if (options.record_path) {
+      movie.record(*nes);
+    }
+  }
+
+  if (options.record_path) {
+    movie.write_file(*options.record_path);
+  }
+
+  if (options.save_state_path) {
+    save_state(*nes, *options.save_state_path);
+  }
+
+  // The hottest instructions are only reported for the counters of the whole run
+  std::vector<HotSpot> hot_spots;
+  std::array<ProfileCounts, 7> ppu_regions {};
+
+  if (profiler && !options.profile_frames) {
+    dump_profile(-1), hot_spots = profiler->hottest(8), ppu_regions = profiler->regions();
+  }
+
+  // The time to write the records left is part of the cost of tracing
+  if (trace_sink) {
+    trace_sink->stop();
+  }
+
+  std::chrono::duration<f64> duration = std::chrono::steady_clock::now() - begin;
+
+  const Canvas &canvas = nes->ppu().canvas();
+  uint64 canvas_hash = hash({});
+
+  for (uint16 y = 0; y < Canvas::H; y++) {
+    canvas_hash = hash(canvas.row(y), canvas_hash);
+  }
+
+  f64 seconds = duration.count();
+
+  fmt::print("frames       {:>12} {:>12.2f} frames/s\n", frames, frames / seconds);
+  fmt::print("instructions {:>12} {:>12.2f}M instructions/s\n", instructions, instructions / seconds / 1e6);
+  fmt::print("cycles       {:>12} {:>12.3f}s\n", nes->cycles() - cycles_begin, seconds);
+  fmt::print("framebuffer  {:016X}\n", canvas_hash);
+  fmt::print("ram          {:016X}\n", hash(nes->ram()));
+
+  if (const auto &hit = nes->debugger().hit()) {
+    fmt::print("break        {:04X} at cycle {}, {}\n", hit->address, hit->cycle, nes->cpu().registers());
+  }
+
+  if (golden_log) {
+    fmt::print("golden       {:>12} lines matched\n", golden_log->lines());
+  }
+
+  for (const HotSpot &hot_spot : hot_spots) {
+    if (hot_spot.bank) {
+      fmt::print("hot          prg {:>2}:{:04X} {:>12} executes\n", hot_spot.bank, hot_spot.address, hot_spot.executes);
+    } else {
+      fmt::print("hot          cpu    {:04X} {:>12} executes\n", hot_spot.address, hot_spot.executes);
+    }
+  }
+
+  constexpr std::string_view REGIONS[] = {"pattern 0", "pattern 1", "nametable 0", "nametable 1", "nametable 2", "nametable 3", "palette"};
+
+  for (uint8 n = 0; n < ppu_regions.size(); n++) {
+    if (const auto &counts = ppu_regions[n]; counts[PROFILE_READ] || counts[PROFILE_WRITE]) {
+      fmt::print("ppu          {:>11} {:>12} reads {:>12} writes\n", REGIONS[n], counts[PROFILE_READ], counts[PROFILE_WRITE]);
+    }
+  }
+
+  if (options.timings_path) {
+    std::ofstream fstream {&(*options.timings_path)[0]};
+
+    if (!fstream) {
+      throw Exception {"Can't write timings file to: '{}'", *options.timings_path};
+    }
+
+    timings.write_json(fstream);
+
+    // The upload and the present only exist in the app
+    for (uint8 n = SUBSYSTEM_CPU; n <= SUBSYSTEM_SPRITES; n++) {
+      TimeSummary summary = timings.summary(Subsystem(n));
+
+      fmt::print(
+        "{:<12} {:>9.1f}us p50 {:>9.1f}us p99 {:>9.1f}us max\n",
+        SUBSYSTEM_NAMES[n],
+        summary.p50.count() / 1e3,
+        summary.p99.count() / 1e3,
+        summary.max.count() / 1e3
+      );
+    }
+  }
+
+  if (perf_counters && !perf_counters->available()) {
+    fmt::print("perf         unavailable, {}\n", perf_counters->error());
+  } else if (perf_counters) {
+    if (auto ipc = perf_counts.ipc()) {
+      fmt::print("perf         {:>12.3f} host instructions per cycle\n", *ipc);
+    }
+
+    // Per emulated frame and per emulated CPU instruction
+    for (uint8 n = 0; n < PERF_EVENT_COUNT; n++) {
+      if (auto count = perf_counts.events[n]) {
+        fmt::print(
+          "{:<13}{:>12.1f} per frame {:>10.3f} per instruction\n",
+          PERF_EVENT_NAMES[n],
+          f64(*count) / std::max<uint64>(1, frames),
+          f64(*count) / std::max<uint64>(1, instructions)
+        );
+      } else {
+        fmt::print("{:<13}{:>12}\n", PERF_EVENT_NAMES[n], "unavailable");
+      }
+    }
+  }
+
+  if (trace_sink) {
+    fmt::print("trace        {:>12} records\n", trace_sink->records());
+  }
+
+  if (run_ahead.frames()) {
+    fmt::print("run-ahead    {:>12} {:>12.3f}ms per frame\n", run_ahead.frames(), run_ahead.overhead().count());
+  }
+}
+
+int main(int argc, const char **argv) {
+  if (argc < 2 || std::strcmp(argv[1], "-h") < 1 || std::strcmp(argv[1], "--help") < 1) {
+    std::cout << CLI_USAGE;
+    return 0;
+  }
+
+  // Dismiss the first argument
+  std::span<const char *> args {argv + 1, argv + argc};
+
+  try {
+    run(parse_options(args));
+  } catch (const std::exception &exception) {
+    std::cerr << "Exception raised: " << exception.what() << std::endl;
+    return 1;
+  } catch (const nemu::Exception &exception) {
+    std::cerr << exception.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "script.hpp"
+#include "exception.hpp"
+#include "nes.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace nemu {
+
+constexpr std::pair<std::string_view, GamepadButton> BUTTONS[] = {
+  {"A", NES_GAMEPAD_A},
+  {"B", NES_GAMEPAD_B},
+  {"SELECT", NES_GAMEPAD_SELECT},
+  {"START", NES_GAMEPAD_START},
+  {"UP", NES_GAMEPAD_UP},
+  {"DOWN", NES_GAMEPAD_DOWN},
+  {"LEFT", NES_GAMEPAD_LEFT},
+  {"RIGHT", NES_GAMEPAD_RIGHT},
+};
+
+Script Script::parse_file(std::string_view path) {
+  std::ifstream fstream {&path[0]};
+
+  if (!fstream) {
+    throw Exception {"Can't open input script from: '{}'", path};
+  }
+
+  Script script;
+  std::string line;
+
+  for (uint64 n = 1; std::getline(fstream, line); n++) {
+    std::istringstream sstream {line.substr(0, line.find('#'))};
+    ScriptEntry entry {};
+    uint16 gamepad;
+
+    // Blank lines and comments
+    if (!(sstream >> entry.frame)) {
+      continue;
+    }
+
+    if (!(sstream >> gamepad) || gamepad > 1) {
+      throw Exception {"Invalid gamepad at line {} of the input script: '{}'", n, path};
+    }
+
+    entry.gamepad = gamepad;
+
+    for (std::string name; sstream >> name;) {
+      auto button = std::ranges::find(BUTTONS, name, &std::pair<std::string_view, GamepadButton>::first);
+
+      if (button == std::end(BUTTONS)) {
+        throw Exception {"Unknown button '{}' at line {} of the input script: '{}'", name, n, path};
+      }
+
+      entry.buttons |= button->second;
+    }
+
+    script.m_entries.push_back(entry);
+  }
+
+  std::ranges::stable_sort(script.m_entries, {}, &ScriptEntry::frame);
+  return script;
+}
+
+void Script::apply(Nes &nes, uint64 frame) {
+  for (; m_next < m_entries.size() && m_entries[m_next].frame <= frame; m_next++) {
+    auto [_, gamepad, buttons] = m_entries[m_next];
+
+    nes.gamepads()[gamepad].release_button(GamepadButton(0xFF));
+    nes.gamepads()[gamepad].press_button(GamepadButton(buttons));
+  }
+}
+
+}  // namespace nemu
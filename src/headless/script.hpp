@@ -0,0 +1,34 @@
+#ifndef NEMU_SCRIPT_HPP
+#define NEMU_SCRIPT_HPP
+
+#include "int.hpp"
+#include <string_view>
+#include <vector>
+
+namespace nemu {
+
+class Nes;
+
+// Gamepad state applied from the start of a frame until the next entry for the same gamepad
+struct ScriptEntry {
+  uint64 frame;
+  uint8 gamepad;
+  uint8 buttons;
+};
+
+// Scripted input, one '<frame> <gamepad> <buttons...>' entry per line
+class Script {
+public:
+  static Script parse_file(std::string_view path);
+
+  // Apply the entries of the frame, entries must be applied in frame order
+  void apply(Nes &nes, uint64 frame);
+
+private:
+  std::vector<ScriptEntry> m_entries;
+  size_t m_next {};
+};
+
+}  // namespace nemu
+
+#endif
@@ -1,15 +1,27 @@
 #include "app.hpp"
 #include "nes.hpp"
+#include "rewind.hpp"
+#include "run_ahead.hpp"
 #include <SDL2/SDL_timer.h>
 #include <chrono>
+#include <exception>
+#include <fmt/format.h>
 #include <fstream>
 #include <iterator>
+#include <memory>
 #include <thread>
+#include <utility>
 
 namespace nemu {
 
-constexpr uint64 FRAME_DELTA = 1000 / 60;
-constexpr uint64 FRAME_TICKS = 341 * 260 / 3;
+constexpr std::chrono::nanoseconds FRAME_DURATION {1'000'000'000 / 60};
+
+// Snapshot every other frame, keeping up to a minute of rewind
+constexpr uint32 REWIND_INTERVAL = 2;
+constexpr uint32 REWIND_SNAPSHOTS = 60 * 60 / REWIND_INTERVAL;
+constexpr size_t REWIND_MEMORY = 4 << 20;
+
+constexpr std::string_view TIMINGS_PATH = "assets/timings.json";
 
 App::App(std::span<const char *> args) :
   m_window {m_user.window_info},
@@ -20,49 +32,164 @@ App::App(std::span<const char *> args) :
   m_username {args[0]} {}
 
 void App::run() {
-  Rom rom {m_rom_data};
-  Nes nes {rom};
-
   m_user = m_sdata.at(m_username);
   m_window.setup();
   m_renderer.setup(m_window);
-  nes.init();
-
-  uint32 timepoint_init = SDL_GetTicks();
-  // Pre/Post frame time points, used to compute the deltatime
-  uint32 timepoint[2] {};
-
-  while (m_state != State::EXIT) {
-    timepoint[0] = SDL_GetTicks();
-    {
-      for (uint64 n = 0; n < FRAME_TICKS; n++) {
-        nes.tick();
-      }
 
-      uint64 time = std::max<uint64>(1, ((timepoint[0] - timepoint_init) / 1000));
-      uint64 fps = nes.ppu().framecount() / time;
+  std::exception_ptr exception;
+  std::atomic<bool> emulating {true};
 
-      m_keyboard.update(nes.gamepads(), m_state);
-      m_window.update(m_state);
-      m_renderer.draw(m_user.window_info, nes.ppu().canvas(), fps);
+  std::thread emulation {[&] {
+    try {
+      emulate();
+    } catch (...) {
+      exception = std::current_exception();
     }
-    timepoint[1] = SDL_GetTicks();
 
-    if (timepoint[1] - timepoint[0] < FRAME_DELTA) {
-      SDL_Delay(FRAME_DELTA - (timepoint[1] - timepoint[0]));
-    }
+    emulating = false;
+  }};
+
+  present(emulating);
 
-    std::swap(timepoint[0], timepoint[1]);
+  // The exit must reach the emulation thread, the queue is drained every frame
+  while (!m_inputs.push({{}, State::EXIT, Speed::NORMAL, false}) && emulating) {
+    std::this_thread::yield();
   }
 
+  emulation.join();
+
   m_renderer.close();
   m_window.close();
 
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+
   // Deserialize the user
   m_sdata[m_username] = sdata::Node {m_username, m_user};
   sdata::write_file("assets/nemu.sd", m_sdata);
 }
 
+void App::emulate() {
+  Rom rom {m_rom_data};
+  auto nes = std::make_unique<Nes>(rom);
+  Rewind rewind {REWIND_SNAPSHOTS, REWIND_INTERVAL, REWIND_MEMORY};
+  RunAhead run_ahead {m_user.run_ahead};
+  Input input {{}, State::INIT, Speed::NORMAL, false};
+
+  // Frames run but not presented add up to the time of the next frame presented
+  FrameTime frame_time {};
+
+  // Frames that are not presented are run without rendering, the PPU timing stays the same
+  auto run_frame = [&](bool presented) {
+    nes->ppu().set_rendering(presented);
+
+    // While rewinding, a frame is run from the restored snapshot to draw it
+    if (input.state == State::REWIND) {
+      rewind.rewind(*nes);
+      nes->run_frame();
+      return;
+    }
+
+    if (presented) {
+      run_ahead.run(*nes);
+    } else {
+      nes->run_frame();
+    }
+
+    rewind.record(*nes);
+  };
+
+  auto publish = [&] {
+    m_frames.back().canvas = nes->ppu().canvas();
+    m_frames.back().time = std::exchange(frame_time, {});
+    m_frames.publish();
+  };
+
+  nes->init();
+  nes->set_timings(&frame_time);
+
+  for (auto timepoint = std::chrono::steady_clock::now();;) {
+    while (auto message = m_inputs.pop()) {
+      input = *message;
+    }
+
+    if (input.state == State::EXIT) {
+      break;
+    }
+
+    for (uint8 n = 0; n < 2; n++) {
+      nes->gamepads()[n].release_button(GamepadButton(0xFF));
+      nes->gamepads()[n].press_button(GamepadButton(input.gamepads[n]));
+    }
+
+    // Uncapped, the first frame run once the frame duration has passed is presented
+    if (input.speed == Speed::UNCAPPED) {
+      auto now = std::chrono::steady_clock::now();
+      bool presented = now >= timepoint;
+
+      run_frame(presented);
+
+      if (presented) {
+        publish(), timepoint = now + FRAME_DURATION;
+      }
+
+      continue;
+    }
+
+    for (uint8 n = 1; n <= static_cast<uint8>(input.speed); n++) {
+      run_frame(n == static_cast<uint8>(input.speed));
+    }
+
+    publish();
+
+    // Frames late by more than one are dropped rather than caught up
+    timepoint = std::max(timepoint, std::chrono::steady_clock::now() - FRAME_DURATION) + FRAME_DURATION;
+    std::this_thread::sleep_until(timepoint);
+  }
+
+  if (run_ahead.frames()) {
+    fmt::print("Run-ahead of {} frames: {:.3f} ms per frame\n", run_ahead.frames(), run_ahead.overhead().count());
+  }
+}
+
+void App::present(const std::atomic<bool> &emulating) {
+  uint32 timepoint_init = SDL_GetTicks(), timepoint_dump = timepoint_init;
+  uint64 frames = 0;
+
+  Input input {{}, m_state, Speed::NORMAL, false}, sent = input;
+  bool pending = true;
+
+  while (m_state != State::EXIT && emulating) {
+    m_keyboard.update(input);
+    m_window.update(input.state);
+    m_state = input.state;
+
+    // A full queue keeps the input pending until the next poll
+    if (pending || input != sent) {
+      pending = !m_inputs.push(input), sent = input;
+    }
+
+    if (!m_frames.acquire()) {
+      SDL_Delay(1);
+      continue;
+    }
+
+    uint64 time = std::max<uint64>(1, (SDL_GetTicks() - timepoint_init) / 1000);
+    uint64 fps = ++frames / time;
+
+    Frame &frame = m_frames.front();
+    m_renderer.draw(m_user.window_info, frame.canvas, fps, frame.time, input.overlay ? &m_timings : nullptr);
+    m_timings.push(frame.time);
+
+    // Written from this thread, a dump every few seconds doesn't weigh on the frames
+    if (m_user.timings_interval && SDL_GetTicks() - timepoint_dump >= m_user.timings_interval * 1000) {
+      std::ofstream fstream {&TIMINGS_PATH[0]};
+      m_timings.write_json(fstream), timepoint_dump = SDL_GetTicks();
+    }
+  }
+}
+
 std::vector<uint8> App::parse_rom(std::string_view path) const {
   std::ifstream fstream {&path[0], std::ios::binary};
 
@@ -1,10 +1,15 @@
 #ifndef NEMU_APP_HPP
 #define NEMU_APP_HPP
 
+#include "frame_timings.hpp"
 #include "keyboard.hpp"
+#include "ppu/ppu.hpp"
 #include "renderer.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
 #include "user.hpp"
 #include "window.hpp"
+#include <atomic>
 #include <span>
 
 namespace nemu {
@@ -13,15 +18,48 @@ enum class State : uint32 {
   INIT,
   RUN,
   PAUSE,
+  REWIND,
   EXIT,
 };
 
+// Count of frames emulated per presented frame, as fast as possible when uncapped
+enum class Speed : uint8 {
+  UNCAPPED = 0,
+  NORMAL = 1,
+  DOUBLE = 2,
+  QUADRUPLE = 4,
+};
+
+// Input polled by the SDL thread, handed over to the emulation thread when it changes
+struct Input {
+  uint8 gamepads[2];
+  State state;
+  Speed speed;
+
+  // Draw the frame timings over the frames, only read by the SDL thread
+  bool overlay;
+
+  bool operator==(const Input &input) const = default;
+};
+
+// Frame published by the emulation thread, with the time the console took to run it
+struct Frame {
+  Canvas canvas;
+  FrameTime time;
+};
+
 class App {
 public:
   App(std::span<const char *> args);
   void run();
   
 private:
+  // Run the console on its own thread, paced by the emulation clock
+  void emulate();
+
+  // Poll the events and present the frames published, on the SDL thread
+  void present(const std::atomic<bool> &emulating);
+
   std::vector<uint8> parse_rom(std::string_view path) const;
 
   State m_state;
@@ -31,6 +69,12 @@ private:
   Keyboard m_keyboard;
   std::vector<uint8> m_rom_data;
 
+  TripleBuffer<Frame> m_frames;
+  SpscQueue<Input, 64> m_inputs;
+
+  // Timings of the frames presented, only touched by the SDL thread
+  FrameTimings m_timings;
+
   sdata::Node m_sdata;
   std::string_view m_username;
 };
@@ -18,22 +18,44 @@ Keyboard::Keyboard(Keymap &keymap) :
     {m_keymap.gamepad.right, NES_GAMEPAD_RIGHT},
   }} {}
 
-void Keyboard::update(Gamepad (&gamepads)[2], State &state) const {
+void Keyboard::update(Input &input) {
   for (auto &[key, button] : m_gamepad_map) {
     if (m_keystate[key]) {
-      gamepads[0].press_button(button);
+      input.gamepads[0] |= button;
     } else {
-      gamepads[0].release_button(button);
+      input.gamepads[0] &= ~button;
     }
   }
 
+  if (m_keystate[m_keymap.app.rewind]) {
+    input.state = State::REWIND;
+  } else if (input.state == State::REWIND) {
+    input.state = State::RUN;
+  }
+
   if (m_keystate[m_keymap.app.exit]) {
-    state = State::EXIT;
+    input.state = State::EXIT;
   }
 
   if (m_keystate[m_keymap.app.pause]) {
-    state = State::PAUSE;
+    input.state = State::PAUSE;
+  }
+
+  if (m_keystate[m_keymap.app.speed] && !m_speed_held) {
+    switch (input.speed) {
+    case Speed::NORMAL: input.speed = Speed::DOUBLE; break;
+    case Speed::DOUBLE: input.speed = Speed::QUADRUPLE; break;
+    case Speed::QUADRUPLE: input.speed = Speed::UNCAPPED; break;
+    case Speed::UNCAPPED: input.speed = Speed::NORMAL; break;
+    }
+  }
+
+  if (m_keystate[m_keymap.app.timings] && !m_timings_held) {
+    input.overlay = !input.overlay;
   }
+
+  m_speed_held = m_keystate[m_keymap.app.speed];
+  m_timings_held = m_keystate[m_keymap.app.timings];
 }
 
 std::span<const uint8> Keyboard::keystate() const {
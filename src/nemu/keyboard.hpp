@@ -8,13 +8,13 @@
 
 namespace nemu {
 
-class Gamepad;
-enum class State : uint32;
+struct Input;
 
 class Keyboard {
 public:
   Keyboard(Keymap &keymap);
-  void update(Gamepad (&gamepads)[2], State &state) const;
+  // Read the buttons of the first gamepad, the app state, the speed and the overlay from the keys held
+  void update(Input &input);
 
 private:
   std::span<const uint8> keystate() const;
@@ -22,6 +22,9 @@ private:
   Keymap &m_keymap;
   std::span<const uint8> m_keystate;
   std::array<std::pair<int32 &, GamepadButton>, 8> m_gamepad_map;
+
+  // The speed and the overlay change once per key press
+  bool m_speed_held {}, m_timings_held {};
 };
 
 }  // namespace nemu
@@ -15,7 +15,7 @@ struct Keymap {
   } gamepad;
 
   struct App {
-    int32 exit, pause;
+    int32 exit, pause, rewind, speed, timings;
   } app;
 };
 
@@ -60,6 +60,9 @@ struct Serializer<Keymap> : Convert<Keymap> {
         {
           to_node(app.exit, "exit"),
           to_node(app.pause, "pause"),
+          to_node(app.rewind, "rewind"),
+          to_node(app.speed, "speed"),
+          to_node(app.timings, "timings"),
         },
       }};
   }
@@ -94,6 +97,9 @@ struct Serializer<Keymap> : Convert<Keymap> {
       .app {
         from_node(app, "exit"),
         from_node(app, "pause"),
+        from_node(app, "rewind"),
+        from_node(app, "speed"),
+        from_node(app, "timings"),
       },
     };
   }
@@ -2,6 +2,7 @@
 #define NEMU_RENDERER_HPP
 
 #include "SDL2/SDL_render.h"
+#include "frame_timings.hpp"
 #include "int.hpp"
 #include <array>
 
@@ -14,11 +15,13 @@ class Window;
 class Renderer {
 public:
   void setup(Window &window);
-  void draw(const WindowInfo &window_info, Canvas &canvas, uint64 fps);
+  // Add the time of the upload and the present to the frame time, the overlay draws the timings over the canvas
+  void draw(const WindowInfo &window_info, Canvas &canvas, uint64 fps, FrameTime &time, const FrameTimings *overlay);
   void close();
 
 private:
   void draw_fps(const WindowInfo &window_info, Canvas &canvas, uint64 fps, uint8 n = 1);
+  void draw_timings(Canvas &canvas, const FrameTimings &timings);
   void draw_nes(const WindowInfo &window_info, Canvas &canvas);
 
   SDL_Renderer *m_renderer;
@@ -0,0 +1,53 @@
+#ifndef NEMU_SPSC_QUEUE_HPP
+#define NEMU_SPSC_QUEUE_HPP
+
+#include "int.hpp"
+#include <array>
+#include <atomic>
+#include <optional>
+
+namespace nemu {
+
+// Lock-free bounded queue between a single producer thread and a single consumer thread
+template<typename T, size_t N>
+class SpscQueue {
+  static_assert((N & (N - 1)) == 0, "The capacity must be a power of two");
+
+public:
+  // False when the queue is full, the value is not pushed
+  inline bool push(const T &value) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+
+    if (tail - m_head.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+
+    m_items[tail & (N - 1)] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  inline std::optional<T> pop() {
+    size_t head = m_head.load(std::memory_order_relaxed);
+
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+
+    T value = m_items[head & (N - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+
+    return value;
+  }
+
+private:
+  std::array<T, N> m_items {};
+
+  alignas(64) std::atomic<size_t> m_head {};
+  alignas(64) std::atomic<size_t> m_tail {};
+};
+
+}  // namespace nemu
+
+#endif
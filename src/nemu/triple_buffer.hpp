@@ -0,0 +1,53 @@
+#ifndef NEMU_TRIPLE_BUFFER_HPP
+#define NEMU_TRIPLE_BUFFER_HPP
+
+#include "int.hpp"
+#include <array>
+#include <atomic>
+
+namespace nemu {
+
+// Lock-free handover of the latest value from a producer thread to a consumer thread. Each side
+// owns a slot, the third one is exchanged between them and tagged when it holds a new value
+template<typename T>
+class TripleBuffer {
+public:
+  // Slot the producer writes the next value into
+  inline T &back() {
+    return m_slots[m_back];
+  }
+
+  // Hand the back slot over, replacing the value the consumer didn't take yet
+  inline void publish() {
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Take the latest value published, false when nothing was published since the last one
+  inline bool acquire() {
+    if (!(m_middle.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  // Slot the consumer took, left untouched by the producer until the next acquire
+  inline T &front() {
+    return m_slots[m_front];
+  }
+
+private:
+  constexpr static uint8 INDEX = 0b011, FRESH = 0b100;
+
+  std::array<T, 3> m_slots {};
+
+  // Each index is only touched by its own side, kept on distinct cache lines
+  alignas(64) uint8 m_back {0};
+  alignas(64) uint8 m_front {1};
+  alignas(64) std::atomic<uint8> m_middle {2};
+};
+
+}  // namespace nemu
+
+#endif
@@ -9,6 +9,12 @@ namespace nemu {
 struct User {
   Keymap keymap;
   WindowInfo window_info;
+
+  // Count of frames the presented frame runs ahead of the emulation, zero to disable
+  uint32 run_ahead;
+
+  // Seconds between two dumps of the frame timings, zero to disable
+  uint32 timings_interval;
 };
 
 }  // namespace nemu
@@ -17,11 +23,13 @@ namespace sdata {
 using namespace nemu;
 
 template<>
-struct Serializer<User> : Scheme<User(Keymap, WindowInfo)> {
+struct Serializer<User> : Scheme<User(Keymap, WindowInfo, uint32, uint32)> {
   Map map(User &user) {
     return Map {
       {"keymap", user.keymap},
       {"window", user.window_info},
+      {"run_ahead", user.run_ahead},
+      {"timings_interval", user.timings_interval},
     };
   }
 };
@@ -0,0 +1,119 @@
+#include "allocations.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace nemu::test {
+
+static std::atomic<uint64> g_allocations {};
+
+uint64 allocations() {
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+static void *allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+  // Zero-sized allocations must still return distinct pointers
+  size = size ? size : 1;
+
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static void *allocate_or_throw(size_t size, size_t alignment = alignof(std::max_align_t)) {
+  if (void *pointer = allocate(size, alignment)) {
+    return pointer;
+  }
+
+  throw std::bad_alloc {};
+}
+
+}  // namespace nemu::test
+
+// Every replaceable form of the global allocation functions goes through the counter
+using nemu::test::allocate, nemu::test::allocate_or_throw;
+
+void *operator new(size_t size) {
+  return allocate_or_throw(size);
+}
+
+void *operator new[](size_t size) {
+  return allocate_or_throw(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  return allocate_or_throw(size, size_t(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return allocate_or_throw(size, size_t(alignment));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return allocate(size, size_t(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return allocate(size, size_t(alignment));
+}
+
+void operator delete(void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
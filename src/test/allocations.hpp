@@ -0,0 +1,26 @@
+#ifndef NEMU_TEST_ALLOCATIONS_HPP
+#define NEMU_TEST_ALLOCATIONS_HPP
+
+#include "int.hpp"
+
+namespace nemu::test {
+
+// Count of the calls to the global operator new since the start of the program, from every thread
+uint64 allocations();
+
+// Allocations made since the counter was created
+class AllocationCounter {
+public:
+  AllocationCounter() : m_begin {allocations()} {}
+
+  inline uint64 count() const {
+    return allocations() - m_begin;
+  }
+
+private:
+  uint64 m_begin;
+};
+
+}  // namespace nemu::test
+
+#endif
@@ -1 +1,2 @@
-int main() {}
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
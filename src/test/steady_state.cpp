@@ -0,0 +1,82 @@
+#include "allocations.hpp"
+#include "frame_timings.hpp"
+#include "nes.hpp"
+#include "rewind.hpp"
+#include "run_ahead.hpp"
+#include "workload.hpp"
+#include <catch2/catch.hpp>
+#include <memory>
+
+using namespace nemu;
+using workload::Console;
+
+// Warm-up fills the decode cache, the pattern cache and the rewind ring
+constexpr uint32 WARMUP_FRAMES = 600;
+constexpr uint32 STEADY_FRAMES = 3000;
+
+TEST_CASE("The frame loop doesn't allocate once warmed up", "[allocations]") {
+  auto [name, program, nmi] = GENERATE(
+    std::tuple {"workload", std::span<const uint8> {workload::WORKLOAD_PROGRAM}, workload::WORKLOAD_NMI},
+    std::tuple {"render", std::span<const uint8> {workload::RENDER_PROGRAM}, workload::RENDER_NMI}
+  );
+
+  uint8 mapper = GENERATE(0, 1);
+  uint32 run_ahead_frames = GENERATE(0, 2);
+
+  CAPTURE(name, mapper, run_ahead_frames);
+
+  Console console {program, nmi, mapper};
+  Nes &nes = *console.nes;
+
+  // The same steps as the emulation thread of the app, with its timings
+  Rewind rewind {1800, 2, 4 << 20};
+  RunAhead run_ahead {run_ahead_frames};
+  FrameTime frame_time {};
+  FrameTimings timings;
+  nes.set_timings(&frame_time);
+
+  auto run_frame = [&](uint32 frame) {
+    nes.gamepads()[0].release_button(GamepadButton(0xFF));
+    nes.gamepads()[0].press_button(GamepadButton(frame * 0x9E3779B1 >> 24));
+
+    run_ahead.run(nes);
+    rewind.record(nes);
+
+    timings.push(std::exchange(frame_time, {}));
+    timings.summary(SUBSYSTEM_CPU), timings.total();
+  };
+
+  for (uint32 frame = 0; frame < WARMUP_FRAMES; frame++) {
+    run_frame(frame);
+  }
+
+  test::AllocationCounter counter;
+
+  for (uint32 frame = 0; frame < STEADY_FRAMES; frame++) {
+    run_frame(frame);
+  }
+
+  // Rewinding restores the snapshots in place
+  for (uint32 frame = 0; frame < 120 && rewind.rewind(nes); frame++) {
+    nes.run_frame();
+  }
+
+  REQUIRE(counter.count() == 0);
+}
+
+TEST_CASE("Nes::tick doesn't allocate once warmed up", "[allocations]") {
+  Console console {workload::RENDER_PROGRAM, workload::RENDER_NMI, 0};
+  Nes &nes = *console.nes;
+
+  for (uint32 cycle = 0; cycle < 60 * 29781; cycle++) {
+    nes.tick();
+  }
+
+  test::AllocationCounter counter;
+
+  for (uint32 cycle = 0; cycle < 600 * 29781; cycle++) {
+    nes.tick();
+  }
+
+  REQUIRE(counter.count() == 0);
+}
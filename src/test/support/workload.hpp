@@ -0,0 +1,108 @@
+#ifndef NEMU_TEST_WORKLOAD_HPP
+#define NEMU_TEST_WORKLOAD_HPP
+
+#include "int.hpp"
+#include "nes.hpp"
+#include "rom.hpp"
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace nemu::workload {
+
+// Programs are mapped at the start of the PRG-ROM where the reset vector points
+constexpr uint16 PROGRAM_RESET = 0x8000;
+
+// NROM program looping over zero page arithmetic, an indexed RAM fill, shifts and a subroutine
+// call with NMI enabled, it never touches the PPU after the setup
+constexpr uint8 WORKLOAD_PROGRAM[] = {
+  0x78, 0xD8, 0xA2, 0xFF, 0x9A, 0xA9, 0x80, 0x8D, 0x00, 0x20, 0xA2, 0x00, 0x8A, 0x65, 0x10,
+  0x85, 0x10, 0x9D, 0x00, 0x02, 0x45, 0x11, 0x85, 0x11, 0xE8, 0xD0, 0xF1, 0xA0, 0x08, 0x46,
+  0x12, 0x26, 0x13, 0x88, 0xD0, 0xF9, 0x20, 0x2C, 0x80, 0xE6, 0x14, 0x4C, 0x0A, 0x80, 0xA5,
+  0x14, 0x29, 0x0F, 0x09, 0x80, 0x85, 0x15, 0x60, 0x48, 0xE6, 0x16, 0x68, 0x40,
+};
+
+constexpr uint16 WORKLOAD_NMI = 0x8035;
+
+// Accumulator and register arithmetic with a short forward branch, no memory access but the zero page
+constexpr uint8 ALU_PROGRAM[] = {
+  0x78, 0xD8, 0xA2, 0xFF, 0x9A, 0x18, 0x69, 0x03, 0x29, 0x7F, 0x09, 0x01, 0x45, 0x10, 0x85,
+  0x10, 0xAA, 0xE8, 0x88, 0xC9, 0x40, 0x90, 0x01, 0x4A, 0x0A, 0x4C, 0x05, 0x80, 0x40,
+};
+
+constexpr uint16 ALU_NMI = 0x801C;
+
+// Absolute indexed, indirect indexed and read-modify-write accesses to the RAM
+constexpr uint8 MEMORY_PROGRAM[] = {
+  0x78, 0xD8, 0xA2, 0xFF, 0x9A, 0xA9, 0x00, 0x85, 0x10, 0xA9, 0x03, 0x85, 0x11, 0xA2, 0x00,
+  0xA0, 0x00, 0xBD, 0x00, 0x02, 0x9D, 0x00, 0x04, 0xB1, 0x10, 0x85, 0x20, 0xEE, 0x00, 0x05,
+  0xA5, 0x20, 0x91, 0x10, 0xE8, 0xC8, 0xD0, 0xEB, 0x4C, 0x11, 0x80, 0x40,
+};
+
+constexpr uint16 MEMORY_NMI = 0x8029;
+
+// Tight countdown loop, subroutine call and stack pushes
+constexpr uint8 BRANCH_PROGRAM[] = {
+  0x78, 0xD8, 0xA2, 0xFF, 0x9A, 0xA2, 0x08, 0xCA, 0xD0, 0xFD, 0x20, 0x12, 0x80, 0x48, 0x68,
+  0x4C, 0x05, 0x80, 0x60, 0x40,
+};
+
+constexpr uint16 BRANCH_NMI = 0x8013;
+
+// Fills the palette and the nametables, then renders the background and the sprites with the
+// NMI handler running the OAM DMA and scrolling every frame
+constexpr uint8 RENDER_PROGRAM[] = {
+  0x78, 0xD8, 0xA2, 0xFF, 0x9A, 0x2C, 0x02, 0x20, 0x10, 0xFB, 0x2C, 0x02, 0x20, 0x10, 0xFB,
+  0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20, 0xA2, 0x00, 0x8A, 0x8D, 0x07,
+  0x20, 0xE8, 0xE0, 0x20, 0xD0, 0xF7, 0xA9, 0x20, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06,
+  0x20, 0xA0, 0x04, 0xA2, 0x00, 0x8A, 0x8D, 0x07, 0x20, 0xE8, 0xD0, 0xF9, 0x88, 0xD0, 0xF6,
+  0xA2, 0x00, 0x8A, 0x65, 0x10, 0x85, 0x10, 0x9D, 0x00, 0x02, 0xE8, 0xD0, 0xF5, 0xA9, 0x80,
+  0x8D, 0x00, 0x20, 0xA9, 0x1E, 0x8D, 0x01, 0x20, 0xE6, 0x20, 0x4C, 0x53, 0x80, 0x48, 0xA9,
+  0x02, 0x8D, 0x14, 0x40, 0xE6, 0x11, 0xA5, 0x11, 0x8D, 0x05, 0x20, 0x8D, 0x05, 0x20, 0x68,
+  0x40,
+};
+
+constexpr uint16 RENDER_NMI = 0x8058;
+
+// Build an iNES image with 2 PRG pages holding the program and 1 CHR page of patterns
+inline std::vector<uint8> make_rom(std::span<const uint8> program, uint16 nmi, uint8 mapper = 0) {
+  std::vector<uint8> data(16 + 2 * PRG_PAGE_SIZE + CHR_PAGE_SIZE);
+  uint8 *prg = &data[16], *chr = &data[16 + 2 * PRG_PAGE_SIZE];
+
+  data[0] = 'N', data[1] = 'E', data[2] = 'S', data[3] = 0x1A;
+  data[4] = 2, data[5] = 1, data[6] = mapper << 4;
+
+  std::ranges::copy(program, prg);
+
+  prg[0x7FFA] = nmi & 0xFF, prg[0x7FFB] = nmi >> 8;
+  prg[0x7FFC] = PROGRAM_RESET & 0xFF, prg[0x7FFD] = PROGRAM_RESET >> 8;
+
+  for (uint16 n = 0; n < CHR_PAGE_SIZE; n++) {
+    chr[n] = uint8(n * 0x9E3779B1 >> 24);
+  }
+
+  return data;
+}
+
+inline std::vector<uint8> make_workload_rom() {
+  return make_rom(WORKLOAD_PROGRAM, WORKLOAD_NMI);
+}
+
+// Initialized console running a program, its address must not change since the mapper refers to the ROM
+struct Console {
+  Console(std::span<const uint8> program, uint16 nmi, uint8 mapper = 0) :
+    data {make_rom(program, nmi, mapper)}, rom {data}, nes {std::make_unique<Nes>(rom)} {
+    nes->init();
+  }
+
+  std::vector<uint8> data;
+  Rom rom;
+
+  // The console is too large for the stack
+  std::unique_ptr<Nes> nes;
+};
+
+}  // namespace nemu::workload
+
+#endif